@@ -0,0 +1,92 @@
+#ifndef FANO_BENCH_CORPORA_HPP
+#define FANO_BENCH_CORPORA_HPP
+
+// Synthetic corpora shared by the benchmarks
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace corpora{
+
+// Fixed seeds, the same corpora on every run and machine with the same standard library
+inline std::vector<uint8_t> make_uniform(size_t size){
+    std::mt19937_64 rng(1);
+    std::vector<uint8_t> data(size);
+    for(auto& byte : data){
+        byte = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+// Zipf(s = 1.1) over all byte values, a few symbols dominate
+inline std::vector<uint8_t> make_zipf(size_t size){
+    std::vector<double> weights(256);
+    for(size_t i = 0; i < weights.size(); ++i){
+        weights[i] = 1.0 / std::pow(static_cast<double>(i + 1), 1.1);
+    }
+    std::discrete_distribution<int> dist(weights.begin(), weights.end());
+    std::mt19937_64 rng(2);
+    std::vector<uint8_t> data(size);
+    for(auto& byte : data){
+        byte = static_cast<uint8_t>(dist(rng));
+    }
+    return data;
+}
+
+// Words drawn with Zipf frequencies, separated by spaces, punctuation and line breaks
+inline std::vector<uint8_t> make_text(size_t size){
+    static const char* const words[] = {
+        "the", "of", "and", "to", "a", "in", "is", "that", "for", "it", "as", "was", "with", "be",
+        "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have",
+        "an", "had", "they", "you", "were", "their", "one", "all", "we", "can", "her", "has",
+        "there", "been", "if", "more", "when", "will", "would", "who", "so", "no", "code", "table",
+        "symbol", "frequency", "encoder", "stream", "probability", "message", "length", "Fano"};
+    constexpr size_t word_count = sizeof(words) / sizeof(words[0]);
+    std::vector<double> weights(word_count);
+    for(size_t i = 0; i < word_count; ++i){
+        weights[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    std::discrete_distribution<size_t> word_dist(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> punct(0, 19);
+    std::mt19937_64 rng(3);
+
+    std::string text;
+    text.reserve(size + 16);
+    while(text.size() < size){
+        text += words[word_dist(rng)];
+        const int p = punct(rng);
+        text += p == 0 ? ".\n" : p == 1 ? ", " : " ";
+    }
+    text.resize(size);
+    return {text.begin(), text.end()};
+}
+
+inline std::vector<uint8_t> make_single(size_t size){
+    return std::vector<uint8_t>(size, 'a');
+}
+
+// Every byte value equally often, in a shuffled order
+inline std::vector<uint8_t> make_all256(size_t size){
+    std::vector<uint8_t> data(size);
+    for(size_t i = 0; i < size; ++i){
+        data[i] = static_cast<uint8_t>(i);
+    }
+    std::mt19937_64 rng(4);
+    std::shuffle(data.begin(), data.end(), rng);
+    return data;
+}
+
+using Generator = std::vector<uint8_t>(*)(size_t);
+
+inline const std::pair<const char*, Generator> generators[] = {
+    {"uniform", make_uniform}, {"zipf", make_zipf}, {"text", make_text},
+    {"single", make_single}, {"all256", make_all256}};
+
+}
+
+#endif
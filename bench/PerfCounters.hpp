@@ -0,0 +1,140 @@
+#ifndef FANO_BENCH_PERFCOUNTERS_HPP
+#define FANO_BENCH_PERFCOUNTERS_HPP
+
+// Hardware counters of the calling thread through perf_event_open.
+// All events are opened as one group so they cover exactly the same
+// instructions. Events the kernel or the CPU refuses are left out, and when
+// none can be opened the counters are unavailable and read() returns nothing,
+// so the caller can still report wall-clock times
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfCounters{
+public:
+    enum Event{
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1dMisses,
+        EVENT_COUNT
+    };
+
+    using Values = std::array<std::optional<uint64_t>, EVENT_COUNT>;
+
+    static constexpr const char* names[EVENT_COUNT] = {"cycles", "instructions", "branch_misses", "l1d_misses"};
+
+    PerfCounters(){
+#ifdef __linux__
+        const std::pair<uint32_t, uint64_t> events[EVENT_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}};
+        for(size_t i = 0; i < EVENT_COUNT; ++i){
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = leader_ < 0;
+            // User space only, allowed with perf_event_paranoid up to 2
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+            if(fd < 0){
+                if(error_.empty()){
+                    error_ = std::string(names[i]) + ": " + std::strerror(errno);
+                }
+                continue;
+            }
+            if(leader_ < 0){
+                leader_ = fd;
+            }
+            fds_.push_back(fd);
+            opened_.push_back(static_cast<Event>(i));
+        }
+#else
+        error_ = "perf_event_open is only available on Linux";
+#endif
+    }
+
+    ~PerfCounters(){
+#ifdef __linux__
+        for(int fd : fds_){
+            close(fd);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return leader_ >= 0; }
+
+    bool has(Event event) const{
+        for(Event e : opened_){
+            if(e == event) return true;
+        }
+        return false;
+    }
+
+    // First failure while opening the events, empty when all of them were opened
+    const std::string& error() const { return error_; }
+
+    void start(){
+#ifdef __linux__
+        if(!available()) return;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    void stop(){
+#ifdef __linux__
+        if(!available()) return;
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    // Counts since start(), scaled up when the group was multiplexed with other events
+    Values read() const{
+        Values values{};
+#ifdef __linux__
+        if(!available()) return values;
+        // nr, time_enabled, time_running, one value per event
+        std::vector<uint64_t> data(3 + fds_.size());
+        const ssize_t size = ::read(leader_, data.data(), data.size() * sizeof(uint64_t));
+        if(size != static_cast<ssize_t>(data.size() * sizeof(uint64_t)) || data[2] == 0){
+            return values;
+        }
+        const double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+        for(size_t i = 0; i < opened_.size() && i < data[0]; ++i){
+            values[opened_[i]] = static_cast<uint64_t>(static_cast<double>(data[3 + i]) * scale);
+        }
+#endif
+        return values;
+    }
+
+private:
+    int leader_ = -1;
+    std::vector<int> fds_;
+    std::vector<Event> opened_;
+    std::string error_;
+};
+
+#endif
@@ -0,0 +1,307 @@
+// Throughput benchmark of both engines over generated and user-supplied corpora.
+// Every run prints one record per corpus, engine and operation with the median
+// of several repetitions, in a stable order and format so outputs of two
+// commits can be diffed directly.
+//
+// fano_bench [--size BYTES] [--reps N] [--threads N] [--format json|tsv] [--no-synthetic] [FILE...]
+#include "Decoder.hpp"
+#include "Encoder.hpp"
+#include "Corpora.hpp"
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+#include "UniDecoder.hpp"
+#include "UniEncoder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#define FANO_BENCH_HAS_RUSAGE 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace{
+
+struct Options{
+    size_t size = size_t{16} << 20;
+    unsigned reps = 5;
+    unsigned threads = 0;
+    std::string format = "json";
+    bool synthetic = true;
+    std::vector<std::string> files;
+};
+
+struct Corpus{
+    std::string name;
+    fs::path path;
+    uint64_t size = 0;
+};
+
+struct Result{
+    std::string corpus;
+    std::string engine;
+    std::string operation;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t symbols = 0;
+    double median_seconds = 0;
+    double min_seconds = 0;
+    long peak_rss_kb = 0;
+    bool verified = true;
+};
+
+// Swallows the console previews the engines print
+class NullBuffer : public std::streambuf{
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+void print_usage(){
+    std::cerr << "usage: fano_bench [--size BYTES] [--reps N] [--threads N] [--format json|tsv]"
+                 " [--no-synthetic] [FILE...]\n";
+}
+
+Options parse_options(int argc, char** argv){
+    Options options;
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if(i + 1 >= argc){
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if(arg == "--size") options.size = std::stoull(value());
+        else if(arg == "--reps") options.reps = std::max(1ul, std::stoul(value()));
+        else if(arg == "--threads") options.threads = static_cast<unsigned>(std::stoul(value()));
+        else if(arg == "--format") options.format = value();
+        else if(arg == "--no-synthetic") options.synthetic = false;
+        else if(arg == "--help" || arg == "-h"){
+            print_usage();
+            std::exit(0);
+        }
+        else if(!arg.empty() && arg[0] == '-') throw std::invalid_argument("unknown option " + arg);
+        else options.files.push_back(arg);
+    }
+    if(options.format != "json" && options.format != "tsv"){
+        throw std::invalid_argument("unknown format " + options.format);
+    }
+    return options;
+}
+
+void write_file(const fs::path& path, const std::vector<uint8_t>& data){
+    std::ofstream output(path, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if(!output){
+        throw std::runtime_error("cannot write " + path.string());
+    }
+}
+
+long peak_rss_kb(){
+#ifdef FANO_BENCH_HAS_RUSAGE
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+bool same_contents(const fs::path& a, const fs::path& b){
+    MappedFile first(a.string());
+    MappedFile second(b.string());
+    return first.size() == second.size() &&
+           (first.size() == 0 || std::memcmp(first.data(), second.data(), first.size()) == 0);
+}
+
+// Run job reps times, returns sorted wall times
+std::vector<double> time_runs(unsigned reps, const std::function<void()>& job){
+    std::vector<double> times;
+    for(unsigned i = 0; i < reps; ++i){
+        const auto start = std::chrono::steady_clock::now();
+        job();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        times.push_back(elapsed.count());
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+std::vector<Result> bench_corpus(const Corpus& corpus, const Options& options, const fs::path& work){
+    const fs::path encoded = work / "encoded.bin";
+    const fs::path decoded = work / "decoded.bin";
+    const std::string input = corpus.path.string();
+    std::vector<Result> results;
+
+    auto record = [&](const std::string& engine, const std::string& operation,
+                      const std::vector<double>& times, uint64_t bytes_in, uint64_t bytes_out){
+        Result result;
+        result.corpus = corpus.name;
+        result.engine = engine;
+        result.operation = operation;
+        result.bytes_in = bytes_in;
+        result.bytes_out = bytes_out;
+        result.symbols = corpus.size;
+        result.median_seconds = times[times.size() / 2];
+        result.min_seconds = times.front();
+        result.peak_rss_kb = peak_rss_kb();
+        results.push_back(result);
+        return &results.back();
+    };
+
+    // Fano
+    auto times = time_runs(options.reps, [&]() {
+        Encoder encoder(input, encoded.string());
+        encoder.set_threads(options.threads);
+        encoder.start();
+    });
+    const uint64_t fano_size = fs::file_size(encoded);
+    record("fano", "encode", times, corpus.size, fano_size);
+
+    times = time_runs(options.reps, [&]() {
+        Decoder decoder(encoded.string(), "", decoded.string());
+        decoder.set_threads(options.threads);
+        decoder.start();
+    });
+    record("fano", "decode", times, fano_size, corpus.size)->verified = same_contents(corpus.path, decoded);
+
+    // Uniform
+    times = time_runs(options.reps, [&]() {
+        UniEncoder encoder(input, encoded.string());
+        encoder.set_threads(options.threads);
+        encoder.start();
+    });
+    const uint64_t uniform_size = fs::file_size(encoded);
+    record("uniform", "encode", times, corpus.size, uniform_size);
+
+    times = time_runs(options.reps, [&]() {
+        UniDecoder decoder(encoded.string(), "", decoded.string());
+        decoder.start();
+    });
+    record("uniform", "decode", times, uniform_size, corpus.size)->verified = same_contents(corpus.path, decoded);
+
+    return results;
+}
+
+double mbps(const Result& result){
+    return result.median_seconds <= 0 ? 0.0 : static_cast<double>(result.symbols) / result.median_seconds / 1e6;
+}
+
+double ns_per_symbol(const Result& result){
+    return result.symbols == 0 ? 0.0 : result.median_seconds * 1e9 / static_cast<double>(result.symbols);
+}
+
+// Compressed size over original size
+double ratio(const Result& result){
+    const uint64_t original = result.operation == "encode" ? result.bytes_in : result.bytes_out;
+    const uint64_t compressed = result.operation == "encode" ? result.bytes_out : result.bytes_in;
+    return original == 0 ? 0.0 : static_cast<double>(compressed) / static_cast<double>(original);
+}
+
+void print_result(std::ostream& out, const Result& result, const std::string& format){
+    std::ostringstream line;
+    line.setf(std::ios::fixed);
+    line.precision(3);
+    if(format == "json"){
+        line << "{\"corpus\":\"" << result.corpus << "\",\"engine\":\"" << result.engine
+             << "\",\"operation\":\"" << result.operation << "\",\"bytes_in\":" << result.bytes_in
+             << ",\"bytes_out\":" << result.bytes_out << ",\"symbols\":" << result.symbols
+             << ",\"median_s\":" << result.median_seconds << ",\"min_s\":" << result.min_seconds
+             << ",\"mb_per_s\":" << mbps(result) << ",\"ns_per_symbol\":" << ns_per_symbol(result)
+             << ",\"ratio\":" << ratio(result) << ",\"peak_rss_kb\":" << result.peak_rss_kb
+             << ",\"verified\":" << (result.verified ? "true" : "false") << "}";
+    }
+    else{
+        line << result.corpus << '\t' << result.engine << '\t' << result.operation << '\t'
+             << result.bytes_in << '\t' << result.bytes_out << '\t' << result.symbols << '\t'
+             << result.median_seconds << '\t' << result.min_seconds << '\t' << mbps(result) << '\t'
+             << ns_per_symbol(result) << '\t' << ratio(result) << '\t' << result.peak_rss_kb << '\t'
+             << (result.verified ? "ok" : "MISMATCH");
+    }
+    out << line.str() << std::endl;
+}
+
+}
+
+int main(int argc, char** argv){
+    Options options;
+    try{
+        options = parse_options(argc, argv);
+    }
+    catch(const std::exception& e){
+        std::cerr << "fano_bench: " << e.what() << '\n';
+        print_usage();
+        return 2;
+    }
+
+    Logger& logger = Logger::getInstance();
+    logger.setLogToConsole(false);
+    logger.setLogLevel(Logger::Level::ERROR);
+
+#ifdef FANO_BENCH_HAS_RUSAGE
+    const std::string suffix = std::to_string(getpid());
+#else
+    const std::string suffix = "0";
+#endif
+    const fs::path work = fs::temp_directory_path() / ("fano_bench_" + suffix);
+    fs::create_directories(work);
+
+    std::vector<Corpus> corpora;
+    if(options.synthetic){
+        for(const auto& [name, generate] : corpora::generators){
+            const fs::path path = work / (std::string(name) + ".in");
+            write_file(path, generate(options.size));
+            corpora.push_back({name, path, options.size});
+        }
+    }
+    for(const auto& file : options.files){
+        corpora.push_back({file, file, fs::file_size(file)});
+    }
+
+    // Results go to the real stdout, engine previews to nowhere
+    std::ostream results(std::cout.rdbuf());
+    NullBuffer null_buffer;
+    std::cout.rdbuf(&null_buffer);
+
+    if(options.format == "tsv"){
+        results << "corpus\tengine\toperation\tbytes_in\tbytes_out\tsymbols\tmedian_s\tmin_s\t"
+                   "mb_per_s\tns_per_symbol\tratio\tpeak_rss_kb\tverified" << std::endl;
+    }
+
+    int status = 0;
+    for(const auto& corpus : corpora){
+        try{
+            for(const auto& result : bench_corpus(corpus, options, work)){
+                print_result(results, result, options.format);
+                if(!result.verified) status = 1;
+            }
+        }
+        catch(const std::exception& e){
+            std::cerr << "fano_bench: " << corpus.name << ": " << e.what() << '\n';
+            status = 1;
+        }
+    }
+
+    std::cout.rdbuf(results.rdbuf());
+    fs::remove_all(work);
+    return status;
+}
@@ -0,0 +1,372 @@
+// Microbenchmarks of the bit-level kernels on in-memory buffers.
+// Every kernel runs over a whole corpus several times with no file I/O, and
+// for the repetition with the median time reports cycles, instructions,
+// branch misses and L1 data cache misses per symbol. When the kernel denies
+// perf_event_open the counters are reported as null / "-" and only times remain.
+//
+// fano_micro [--size BYTES] [--reps N] [--format json|tsv] [--isa scalar|bmi2|avx2] [--corpus NAME]...
+#include "BitReader.hpp"
+#include "BitWriter.hpp"
+#include "Code.hpp"
+#include "Corpora.hpp"
+#include "DecodeTable.hpp"
+#include "Decoder.hpp"
+#include "Encoder.hpp"
+#include "Fano.hpp"
+#include "FanoTable.hpp"
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include "OutputBuffer.hpp"
+#include "PerfCounters.hpp"
+#include "SyncIndex.hpp"
+#include "UniDecoder.hpp"
+#include "UniEncoder.hpp"
+#include "UniformKernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace{
+
+struct Options{
+    size_t size = size_t{4} << 20;
+    unsigned reps = 5;
+    std::string format = "json";
+    std::string isa;    // Uniform pack kernels, empty - the best one
+    std::vector<std::string> corpora;
+};
+
+struct Sample{
+    double seconds = 0;
+    PerfCounters::Values counters{};
+};
+
+struct Result{
+    std::string corpus;
+    std::string kernel;
+    uint64_t symbols = 0;
+    uint64_t bits = 0;
+    Sample median;
+    bool verified = true;
+};
+
+// Collects decoded bytes in memory, so the decoders run through the same OutputBuffer as in the engines
+class VectorBuffer : public std::streambuf{
+public:
+    std::vector<uint8_t> bytes;
+
+protected:
+    int overflow(int c) override{
+        if(c != traits_type::eof()){
+            bytes.push_back(static_cast<uint8_t>(c));
+        }
+        return c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override{
+        bytes.insert(bytes.end(), s, s + n);
+        return n;
+    }
+};
+
+void print_usage(){
+    std::cerr << "usage: fano_micro [--size BYTES] [--reps N] [--format json|tsv] [--isa scalar|bmi2|avx2] [--corpus NAME]...\n";
+}
+
+Options parse_options(int argc, char** argv){
+    Options options;
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if(i + 1 >= argc){
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if(arg == "--size") options.size = std::stoull(value());
+        else if(arg == "--reps") options.reps = std::max(1ul, std::stoul(value()));
+        else if(arg == "--format") options.format = value();
+        else if(arg == "--isa") options.isa = value();
+        else if(arg == "--corpus") options.corpora.push_back(value());
+        else if(arg == "--help" || arg == "-h"){
+            print_usage();
+            std::exit(0);
+        }
+        else throw std::invalid_argument("unknown option " + arg);
+    }
+    if(options.format != "json" && options.format != "tsv"){
+        throw std::invalid_argument("unknown format " + options.format);
+    }
+    if(!options.isa.empty()){
+        bool known = false;
+        for(auto isa : {UniformKernels::Isa::Scalar, UniformKernels::Isa::Bmi2, UniformKernels::Isa::Avx2}){
+            if(options.isa == UniformKernels::name(isa)){
+                UniformKernels::set_isa(isa);
+                known = true;
+            }
+        }
+        if(!known){
+            throw std::invalid_argument("unknown isa " + options.isa);
+        }
+    }
+    return options;
+}
+
+// Run job reps times under the counters, returns the repetition with the median time.
+// prepare runs before every repetition, outside the measured region
+Sample measure(PerfCounters& counters, unsigned reps, const std::function<void()>& prepare,
+const std::function<void()>& job){
+    std::vector<Sample> samples;
+    for(unsigned i = 0; i < reps; ++i){
+        prepare();
+        Sample sample;
+        const auto start = std::chrono::steady_clock::now();
+        counters.start();
+        job();
+        counters.stop();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        sample.seconds = elapsed.count();
+        sample.counters = counters.read();
+        samples.push_back(sample);
+    }
+    std::sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b){
+        return a.seconds < b.seconds;
+    });
+    return samples[samples.size() / 2];
+}
+
+std::vector<std::pair<unsigned char, std::string>> code_strings(const std::array<Code, 256>& codes){
+    std::vector<std::pair<unsigned char, std::string>> alphabet;
+    for(size_t i = 0; i < codes.size(); ++i){
+        if(!codes[i].empty()){
+            alphabet.emplace_back(static_cast<unsigned char>(i), codes[i].to_string());
+        }
+    }
+    return alphabet;
+}
+
+std::vector<Result> bench_corpus(const std::string& name, const std::vector<uint8_t>& data,
+const Options& options, PerfCounters& counters){
+    std::vector<Result> results;
+    auto record = [&](const std::string& kernel, uint64_t bits, const Sample& median){
+        Result result;
+        result.corpus = name;
+        result.kernel = kernel;
+        result.symbols = data.size();
+        result.bits = bits;
+        result.median = median;
+        results.push_back(result);
+        return &results.back();
+    };
+    auto nothing = []() {};
+
+    const Histogram::Counts counts = Histogram::count_serial(data);
+    const FanoTable table(counts);
+    const std::array<Code, 256> uni_codes = fano::CodeTable::build(std::as_bytes(std::span(data)), fano::Engine::Uniform).codes();
+
+    std::vector<uint8_t> payload;
+    VectorBuffer sink;
+    std::ostream sink_stream(&sink);
+
+    // Fano: packing loop of the encoder
+    SyncIndex index;
+    uint8_t padding = 0;
+    Sample sample = measure(counters, options.reps, [&]() {
+        payload.clear();
+        payload.reserve(data.size() + 8);
+        index = SyncIndex{};
+    }, [&]() {
+        BitWriter writer(payload);
+        Encoder::encode_span(data, table.codes(), writer, 0, index);
+        padding = writer.finish();
+    });
+    const uint64_t fano_bits = index.total_bits;
+    record("fano_encode", fano_bits, sample);
+
+    // Fano: bit by bit tree walk and the lookup tables over the same payload
+    const std::vector<Node> tree = Decoder::build_tree(code_strings(table.codes()));
+    auto clear_sink = [&]() {
+        sink.bytes.clear();
+        sink.bytes.reserve(data.size());
+    };
+    sample = measure(counters, options.reps, clear_sink, [&]() {
+        OutputBuffer output(sink_stream);
+        Decoder::tree_walk(tree, payload, padding, output);
+        output.flush();
+    });
+    record("fano_tree_walk", fano_bits, sample)->verified = sink.bytes == data;
+
+    const DecodeTable decode_table(table.codes());
+    std::vector<unsigned char> decoded(data.size());
+    size_t decoded_size = 0;
+    sample = measure(counters, options.reps, nothing, [&]() {
+        BitReader reader(payload.data(), payload.size(), fano_bits);
+        decoded_size = decode_table.decode(reader, decoded.data(), decoded.size());
+    });
+    record("fano_table_decode", fano_bits, sample)->verified =
+        decoded_size == data.size() && std::equal(data.begin(), data.end(), decoded.begin());
+
+    // Fano: the same codes dealt over 4 interleaved lanes, one lookup per lane and step
+    const std::vector<uint64_t> lane_bits = Encoder::lane_bits(data, table.codes(), 4);
+    std::vector<uint8_t> lanes;
+    {
+        BitWriter writer(lanes);
+        Encoder::encode_interleaved(data, table.codes(), writer, lane_bits);
+        writer.finish();
+    }
+    sample = measure(counters, options.reps, [&]() { std::fill(decoded.begin(), decoded.end(), 0); }, [&]() {
+        std::vector<BitReader> readers;
+        size_t offset = 8 * lane_bits.size();
+        for(uint64_t bits : lane_bits){
+            readers.emplace_back(lanes.data() + offset, static_cast<size_t>((bits + 7) / 8), bits);
+            offset += static_cast<size_t>((bits + 7) / 8);
+        }
+        decode_table.decode_interleaved(readers.data(), 4, decoded.data(), decoded.size());
+    });
+    record("fano_interleaved_decode", fano_bits, sample)->verified =
+        std::equal(data.begin(), data.end(), decoded.begin());
+
+    // Uniform: packing loop and sub-byte extraction
+    uint64_t uniform_bits = 0;
+    sample = measure(counters, options.reps, [&]() {
+        payload.clear();
+        payload.reserve(data.size() + 8);
+    }, [&]() {
+        BitWriter writer(payload);
+        UniEncoder::encode_span(data, uni_codes, writer);
+        uniform_bits = writer.bit_count();
+        padding = writer.finish();
+    });
+    record("uniform_encode", uniform_bits, sample);
+
+    UniDecoder uni_decoder("", "", "");
+    uni_decoder.set_codes(uni_codes);
+    sample = measure(counters, options.reps, clear_sink, [&]() {
+        OutputBuffer output(sink_stream);
+        uni_decoder.bit_decode(payload.data(), payload.size(), padding, output);
+        output.flush();
+    });
+    record("uniform_bit_decode", uniform_bits, sample)->verified = sink.bytes == data;
+
+    return results;
+}
+
+double per_symbol(uint64_t value, const Result& result){
+    return result.symbols == 0 ? 0.0 : static_cast<double>(value) / static_cast<double>(result.symbols);
+}
+
+void print_result(std::ostream& out, const Result& result, const std::string& format){
+    const auto& c = result.median.counters;
+    const double ns = result.symbols == 0 ? 0.0 : result.median.seconds * 1e9 / static_cast<double>(result.symbols);
+    const double mbps = result.median.seconds <= 0 ? 0.0 : static_cast<double>(result.symbols) / result.median.seconds / 1e6;
+
+    std::ostringstream line;
+    line.setf(std::ios::fixed);
+    line.precision(3);
+    const bool json = format == "json";
+    auto counter = [&](const char* key, const std::optional<double>& value){
+        if(json){
+            line << ",\"" << key << "\":";
+            if(value) line << *value;
+            else line << "null";
+        }
+        else{
+            line << '\t';
+            if(value) line << *value;
+            else line << '-';
+        }
+    };
+    auto per = [&](PerfCounters::Event event) -> std::optional<double> {
+        if(!c[event]) return std::nullopt;
+        return per_symbol(*c[event], result);
+    };
+    std::optional<double> ipc;
+    if(c[PerfCounters::Cycles] && c[PerfCounters::Instructions] && *c[PerfCounters::Cycles] != 0){
+        ipc = static_cast<double>(*c[PerfCounters::Instructions]) / static_cast<double>(*c[PerfCounters::Cycles]);
+    }
+
+    if(json){
+        line << "{\"corpus\":\"" << result.corpus << "\",\"kernel\":\"" << result.kernel
+             << "\",\"symbols\":" << result.symbols << ",\"bits\":" << result.bits
+             << ",\"median_s\":" << result.median.seconds << ",\"mb_per_s\":" << mbps
+             << ",\"ns_per_symbol\":" << ns;
+    }
+    else{
+        line << result.corpus << '\t' << result.kernel << '\t' << result.symbols << '\t' << result.bits << '\t'
+             << result.median.seconds << '\t' << mbps << '\t' << ns;
+    }
+    counter("cycles_per_symbol", per(PerfCounters::Cycles));
+    counter("instructions_per_symbol", per(PerfCounters::Instructions));
+    counter("ipc", ipc);
+    counter("branch_misses_per_symbol", per(PerfCounters::BranchMisses));
+    counter("l1d_misses_per_symbol", per(PerfCounters::L1dMisses));
+    if(json){
+        line << ",\"verified\":" << (result.verified ? "true" : "false") << "}";
+    }
+    else{
+        line << '\t' << (result.verified ? "ok" : "MISMATCH");
+    }
+    out << line.str() << std::endl;
+}
+
+}
+
+int main(int argc, char** argv){
+    Options options;
+    try{
+        options = parse_options(argc, argv);
+    }
+    catch(const std::exception& e){
+        std::cerr << "fano_micro: " << e.what() << '\n';
+        print_usage();
+        return 2;
+    }
+
+    Logger& logger = Logger::getInstance();
+    logger.setLogToConsole(false);
+    logger.setLogLevel(Logger::Level::ERROR);
+
+    PerfCounters counters;
+    if(!counters.available()){
+        std::cerr << "fano_micro: hardware counters unavailable (" << counters.error() << "), reporting times only\n";
+    }
+    else if(!counters.error().empty()){
+        std::cerr << "fano_micro: some hardware counters unavailable (" << counters.error() << ")\n";
+    }
+    std::cerr << "fano_micro: uniform kernels " << UniformKernels::name(UniformKernels::isa()) << '\n';
+
+    if(options.format == "tsv"){
+        std::cout << "corpus\tkernel\tsymbols\tbits\tmedian_s\tmb_per_s\tns_per_symbol\tcycles_per_symbol\t"
+                     "instructions_per_symbol\tipc\tbranch_misses_per_symbol\tl1d_misses_per_symbol\tverified"
+                  << std::endl;
+    }
+
+    int status = 0;
+    for(const auto& [name, generate] : corpora::generators){
+        if(!options.corpora.empty() &&
+           std::find(options.corpora.begin(), options.corpora.end(), name) == options.corpora.end()){
+            continue;
+        }
+        try{
+            for(const auto& result : bench_corpus(name, generate(options.size), options, counters)){
+                print_result(std::cout, result, options.format);
+                if(!result.verified) status = 1;
+            }
+        }
+        catch(const std::exception& e){
+            std::cerr << "fano_micro: " << name << ": " << e.what() << '\n';
+            status = 1;
+        }
+    }
+    return status;
+}
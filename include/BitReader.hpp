@@ -0,0 +1,56 @@
+#ifndef BITREADER_HPP
+#define BITREADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// MSB-first bit reader over an in-memory buffer.
+// Bits past the end of the buffer are read as zeros, so callers
+// must check bits_left() before trusting a peeked value.
+class BitReader{
+public:
+    BitReader(const uint8_t* data, size_t size, uint64_t bit_end, uint64_t bit_pos = 0)
+        : data_(data), size_(size), bit_end_(bit_end), bit_pos_(bit_pos) {}
+
+    // Next n bits (1 <= n <= 57) as an unsigned value, without consuming them
+    uint64_t peek(unsigned n) const{
+        size_t byte = static_cast<size_t>(bit_pos_ >> 3);
+        uint64_t word = 0;
+        if(byte + 8 <= size_){
+            for(size_t i = 0; i < 8; ++i){
+                word = (word << 8) | data_[byte + i];
+            }
+        }
+        else{
+            for(size_t i = 0; i < 8; ++i){
+                word = (word << 8) | (byte + i < size_ ? data_[byte + i] : 0u);
+            }
+        }
+        word <<= (bit_pos_ & 7);
+        return word >> (64 - n);
+    }
+
+    void skip(unsigned n){
+        bit_pos_ += n;
+    }
+
+    void seek(uint64_t bit_pos){
+        bit_pos_ = bit_pos;
+    }
+
+    uint64_t position() const{
+        return bit_pos_;
+    }
+
+    uint64_t bits_left() const{
+        return bit_pos_ < bit_end_ ? bit_end_ - bit_pos_ : 0;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    uint64_t bit_end_;
+    uint64_t bit_pos_;
+};
+
+#endif
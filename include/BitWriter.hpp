@@ -0,0 +1,75 @@
+#ifndef BITWRITER_HPP
+#define BITWRITER_HPP
+
+#include "Code.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// MSB-first bit writer.
+// Bits are collected in a 64-bit accumulator, whole words go to a large
+// buffer which is written to the stream (or appended to a byte vector)
+// when full and on finish()
+class BitWriter{
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = size_t{1} << 20;
+
+    explicit BitWriter(std::ostream& output, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    explicit BitWriter(std::vector<uint8_t>& output, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    // Append the low `length` bits of `bits`, 1 <= length <= 64
+    void put(uint64_t bits, unsigned length){
+        if(length < free_){
+            free_ -= length;
+            acc_ |= bits << free_;
+            return;
+        }
+        const unsigned over = length - free_;
+        acc_ |= bits >> over;
+        write_word(acc_);
+        free_ = 64 - over;
+        acc_ = over == 0 ? 0 : bits << free_;
+    }
+
+    void put(const Code& code){
+        put(code.bits, code.length);
+    }
+
+    // Append whole bytes, the bits put so far must end on a byte boundary
+    void put_bytes(const uint8_t* data, size_t size);
+
+    // Write out the remaining bits, zero-padded to a whole byte, and end the stream.
+    // Returns number of padding bits in the last byte
+    uint8_t finish();
+
+    // Bits put so far
+    uint64_t bit_count() const{
+        return bytes_ * 8 + (64 - free_);
+    }
+
+private:
+    std::ostream* stream_ = nullptr;
+    std::vector<uint8_t>* memory_ = nullptr;
+    std::vector<char> buffer_;
+    size_t pos_ = 0;
+    uint64_t bytes_ = 0;    // moved from the accumulator to buffer_
+
+    uint64_t acc_ = 0;
+    unsigned free_ = 64;
+
+    void write_word(uint64_t word){
+        if(pos_ + sizeof(word) > buffer_.size()){
+            flush_buffer();
+        }
+        for(size_t i = 0; i < sizeof(word); ++i){
+            buffer_[pos_ + i] = static_cast<char>(word >> (56 - 8 * i));
+        }
+        pos_ += sizeof(word);
+        bytes_ += sizeof(word);
+    }
+
+    void flush_buffer();
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef CLI_HPP
+#define CLI_HPP
+
+#include "Metrics.hpp"
+#include "Pipeline.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Non-interactive front end.
+// Arguments describe one operation applied to many files: the inputs from the
+// command line and from a manifest become jobs that run on a bounded pool of
+// workers, every job reports its own result and the exit status tells
+// whether all of them succeeded
+class Cli{
+public:
+    enum class Mode{
+        None,
+        Encode,
+        Decode
+    };
+
+    // Auto - for decoding, the engine recorded in the container
+    enum class Engine{
+        Auto,
+        Fano,
+        Uniform
+    };
+
+    // Exit statuses
+    static constexpr int OK = 0;
+    static constexpr int FAILED = 1;
+    static constexpr int USAGE = 2;
+
+    struct Options{
+        Mode mode = Mode::None;
+        Engine engine = Engine::Auto;
+        std::string output;         // single input only, "-" - stdout
+        std::string output_dir;     // outputs named after inputs in this directory
+        std::string manifest;       // lines "input" or "input<TAB>output", "-" - stdin
+        std::string metrics_path;   // JSON line per finished file
+        size_t block_size = 0;
+        uint64_t sync_interval = 0;
+        unsigned max_code_length = 0;   // 0 - not limited
+        unsigned streams = 1;       // interleaved bitstreams per block
+        bool pipeline = false;      // blocked file to file jobs on a read / code / write pipeline
+        Pipeline::Io pipeline_io = Pipeline::Io::Auto;
+        unsigned threads = 0;       // per file, 0 - all hardware threads for one file, 1 for many
+        unsigned jobs = 0;          // files at once, 0 - one per hardware thread
+        bool quiet = false;
+        std::vector<std::string> inputs;
+    };
+
+    struct Job{
+        std::string input;
+        std::string output;
+    };
+
+    struct Result{
+        bool ok = false;
+        std::string error;
+        Metrics metrics;
+    };
+
+    // Parse argv and run every job, returns OK, FAILED or USAGE
+    static int run(int argc, char** argv);
+
+    static void print_usage(std::ostream& out);
+
+    // Throws std::invalid_argument on bad arguments
+    static Options parse(int argc, char** argv);
+
+    // Jobs of the command line inputs followed by the manifest ones, with output paths resolved
+    static std::vector<Job> make_jobs(const Options& options);
+
+    // Output of input when none was given: input + ".fano" when encoding,
+    // input without ".fano" (or + ".out") when decoding
+    static std::string default_output(const std::string& input, Mode mode, const std::string& output_dir);
+
+    static Result run_job(const Job& job, const Options& options, unsigned threads);
+
+private:
+    static std::vector<Job> read_manifest(const std::string& path);
+
+    // Engine recorded in a container, Fano for other data on stdin. Throws for other files.
+    // The first bytes of stdin are read into head, they go to the decoder
+    static Engine detect_engine(const std::string& path, std::vector<uint8_t>& head);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef CODE_HPP
+#define CODE_HPP
+
+#include <cstdint>
+#include <string>
+
+// Prefix code of a symbol: the low `length` bits of `bits`, first bit is the most significant
+struct Code{
+    static constexpr unsigned MAX_LENGTH = 64;
+
+    uint64_t bits = 0;
+    uint8_t length = 0;
+
+    bool empty() const { return length == 0; }
+
+    // Append one bit to the end of the code
+    void push_back(bool bit){
+        bits = (bits << 1) | static_cast<uint64_t>(bit);
+        ++length;
+    }
+
+    // Code as a string of '0'/'1', as written to the alphabet
+    std::string to_string() const{
+        std::string s(length, '0');
+        for(unsigned i = 0; i < length; ++i){
+            if((bits >> (length - 1 - i)) & 1u){
+                s[i] = '1';
+            }
+        }
+        return s;
+    }
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CONTAINER_HPP
+#define CONTAINER_HPP
+
+#include "Code.hpp"
+#include "SyncIndex.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Binary container for encoded files, all integers are little-endian.
+//
+//   header     magic "FANO", version, engine, flags, code length limit,
+//              original size, block size, block count, lane count
+//   directory  one BlockEntry per block
+//   blocks     code table of the block followed by its payload bits and,
+//              with SYNC_INDEX, the sync index of the block
+//
+// Code table: u16 symbol count, (u8 symbol, u8 code length) per symbol,
+// then all codes back to back, MSB-first, padded to a whole byte.
+// Sync index: u64 interval, u64 point count, (u64 bit offset, u64 output offset) per point.
+// With INTERLEAVED the payload of a block is split into `lanes` bitstreams (2, 4 or 8),
+// symbol i going to lane i % lanes: u64 bit length per lane, then the lanes, each
+// padded to a whole byte. bit_count of the entry is the sum of the lane lengths.
+// Interleaved blocks are Fano coded and have no sync index.
+// A file without BLOCKED holds the whole input as a single block
+class Container{
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 32;
+    static constexpr size_t ENTRY_SIZE = 24;
+
+    enum class Engine : uint8_t{
+        Fano = 0,
+        Uniform = 1
+    };
+
+    enum Flags : uint8_t{
+        BLOCKED = 1 << 0,
+        SYNC_INDEX = 1 << 1,
+        INTERLEAVED = 1 << 2
+    };
+
+    // Lane counts of INTERLEAVED containers
+    static constexpr unsigned MAX_LANES = 8;
+    static bool valid_lanes(unsigned lanes) { return lanes == 2 || lanes == 4 || lanes == 8; }
+
+    struct Header{
+        uint8_t version = VERSION;
+        Engine engine = Engine::Fano;
+        uint8_t flags = 0;
+        uint8_t max_code_length = 0;    // no code of any block is longer, 0 - not limited
+        uint64_t original_size = 0;
+        uint64_t block_size = 0;
+        uint32_t block_count = 0;
+        uint8_t lanes = 1;              // bitstreams per block, more than one with INTERLEAVED
+    };
+
+    struct BlockEntry{
+        uint64_t offset = 0;    // from the start of the file to the code table
+        uint64_t raw_size = 0;  // symbols in the block
+        uint64_t bit_count = 0; // payload length in bits
+    };
+
+    // Whether data starts with the container magic
+    static bool is_container(const uint8_t* data, size_t size);
+
+    static void write_header(std::vector<uint8_t>& out, const Header& header);
+    static Header read_header(const uint8_t* data, size_t size);
+
+    static void write_directory(std::vector<uint8_t>& out, const std::vector<BlockEntry>& entries);
+    static std::vector<BlockEntry> read_directory(const uint8_t* data, size_t size, const Header& header);
+
+    static void write_codes(std::vector<uint8_t>& out, const std::array<Code, 256>& codes);
+    // Returns number of bytes the table takes. Throws on codes longer than max_length, 0 - Code::MAX_LENGTH
+    static size_t read_codes(const uint8_t* data, size_t size, std::array<Code, 256>& codes, unsigned max_length = 0);
+
+    // Lane of an interleaved payload, offset - of its first byte from the payload start
+    struct Lane{
+        uint64_t offset = 0;
+        uint64_t bit_count = 0;
+    };
+
+    // Bytes an interleaved payload with lanes of these lengths takes
+    static uint64_t interleaved_size(const std::vector<uint64_t>& lane_bits);
+    static void write_lane_lengths(std::vector<uint8_t>& out, const std::vector<uint64_t>& lane_bits);
+    // Lanes of an interleaved payload of at most size bytes, checked against the entry
+    static std::vector<Lane> read_lanes(const uint8_t* data, size_t size, const BlockEntry& entry, unsigned lanes);
+    // Bytes the payload of read_lanes() takes
+    static uint64_t lanes_size(const std::vector<Lane>& lanes);
+
+    // Bytes write_index() takes for a block of raw_size symbols
+    static uint64_t index_size(uint64_t raw_size, uint64_t interval);
+    static void write_index(std::vector<uint8_t>& out, const SyncIndex& index);
+    // Index of a block with the given totals, returns number of bytes it takes
+    static size_t read_index(const uint8_t* data, size_t size, const BlockEntry& entry, SyncIndex& index);
+
+    static void put_u16(std::vector<uint8_t>& out, uint16_t value);
+    static void put_u32(std::vector<uint8_t>& out, uint32_t value);
+    static void put_u64(std::vector<uint8_t>& out, uint64_t value);
+    static uint64_t get_le(const uint8_t* data, size_t bytes);
+
+private:
+    static constexpr uint8_t MAGIC[4] = {'F', 'A', 'N', 'O'};
+};
+
+#endif
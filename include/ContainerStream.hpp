@@ -0,0 +1,61 @@
+#ifndef CONTAINERSTREAM_HPP
+#define CONTAINERSTREAM_HPP
+
+#include "Container.hpp"
+#include "DecodeTable.hpp"
+#include "OutputBuffer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Front to back reader of a container on a stream that cannot be mapped (stdin, pipes).
+// Only the header, the directory, one code table and a window of the payload
+// are held in memory, so decoding does not depend on the size of the input
+class ContainerStream{
+public:
+    static constexpr size_t CHUNK_SIZE = size_t{1} << 20;
+
+    // First bytes of input, enough to tell a container from other data
+    static std::vector<uint8_t> read_head(std::istream& input);
+
+    // head - first bytes of input, already read by the caller. Reads header and directory
+    ContainerStream(std::istream& input, std::vector<uint8_t> head, std::string name);
+
+    const Container::Header& header() const { return header_; }
+    const std::vector<Container::BlockEntry>& entries() const { return entries_; }
+
+    // Decode every block into output with the lookup tables, returns payload bits
+    uint64_t decode(OutputBuffer& output);
+
+    // Bytes of the input consumed so far
+    uint64_t position() const { return offset_ + pos_; }
+
+private:
+    std::istream& input_;
+    std::string name_;
+    Container::Header header_;
+    std::vector<Container::BlockEntry> entries_;
+
+    // Window [pos_, buffer_.size()) of unread bytes, buffer_[0] is input byte offset_
+    std::vector<uint8_t> buffer_;
+    size_t pos_ = 0;
+    uint64_t offset_ = 0;
+
+    const uint8_t* data() const { return buffer_.data() + pos_; }
+    size_t available() const { return buffer_.size() - pos_; }
+
+    // Read until at least n bytes are available or the input ends, returns available() >= n
+    bool fill(size_t n);
+
+    // Drop bytes up to input offset, reading through the ones not yet read
+    void skip_to(uint64_t offset);
+
+    void decode_block(size_t block, OutputBuffer& output);
+
+    // Rest of an interleaved block after its code table, the payload is read whole
+    void decode_lanes(size_t block, const DecodeTable& table, OutputBuffer& output);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef DECODETABLE_HPP
+#define DECODETABLE_HPP
+
+#include "BitReader.hpp"
+#include "Code.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Multi-level lookup table for prefix codes.
+// The root level is indexed by the next bits_ bits of the stream and resolves
+// up to MAX_SYMBOLS symbols per lookup; longer codes escape to sub levels.
+class DecodeTable{
+public:
+    static constexpr unsigned DEFAULT_BITS = 11;
+    static constexpr unsigned MAX_BITS = 16;
+    static constexpr unsigned MAX_SYMBOLS = 4;
+    // Widest root level chosen for a known code length limit
+    static constexpr unsigned SINGLE_LEVEL_BITS = 12;
+
+    // Root width for codes no longer than max_length, 0 - unknown. Codes up to
+    // SINGLE_LEVEL_BITS are all resolved by the root, longer ones by one more level at most
+    static unsigned root_bits(unsigned max_length);
+
+    // codes - pairs (symbol, code string of '0'/'1') as read from the alphabet
+    explicit DecodeTable(const std::vector<std::pair<unsigned char, std::string>>& codes,
+    unsigned bits = DEFAULT_BITS);
+
+    // codes - code of every symbol, empty for symbols not in the alphabet
+    explicit DecodeTable(const std::array<Code, 256>& codes, unsigned bits = DEFAULT_BITS);
+
+    // Decode symbols from reader into out until the stream or out is exhausted.
+    // With reserve != 0 decoding stops once fewer than reserve bits are left, so a
+    // window over a longer stream never decodes a code cut at its end.
+    // Returns number of symbols written
+    size_t decode(BitReader& reader, unsigned char* out, size_t capacity, unsigned reserve = 0) const;
+
+    // Decode count symbols dealt round-robin over lanes readers, symbol i from readers[i % lanes],
+    // lanes - 2, 4 or 8. Every step looks up one symbol of each lane, the lookups do not depend
+    // on each other, so they overlap instead of waiting for the end of the previous code.
+    // Throws if a lane ends early, the caller checks that none is left with bits
+    void decode_interleaved(BitReader* readers, unsigned lanes, unsigned char* out, size_t count) const;
+
+    unsigned bits() const { return bits_; }
+
+    // Length of the longest code
+    unsigned max_length() const { return max_length_; }
+
+private:
+    struct Entry{
+        unsigned char symbols[MAX_SYMBOLS];
+        uint8_t count = 0;      // resolved symbols, 0 for escape or invalid prefix
+        uint8_t bits = 0;       // bits consumed by all resolved symbols
+        uint8_t first_bits = 0; // bits consumed by the first symbol alone
+        uint8_t sub_bits = 0;   // index width of the next level, 0 for invalid prefix
+        uint32_t sub = 0;       // start of the next level in entries_
+    };
+
+    struct CodeRef{
+        unsigned char symbol;
+        const std::string* code;
+    };
+
+    unsigned bits_;
+    unsigned max_length_ = 0;
+
+    // All levels, root level first
+    std::vector<Entry> entries_;
+
+    void build(const std::vector<std::pair<unsigned char, std::string>>& codes);
+
+    uint32_t build_level(const std::vector<CodeRef>& group, size_t offset, unsigned width);
+
+    void join_root_symbols();
+
+    // Decode a single symbol with bound checks on every level
+    unsigned char decode_one(BitReader& reader) const;
+
+    // Whole rounds of one symbol per lane while every lane has a root index left, returns rounds done
+    template<unsigned Lanes>
+    size_t decode_rounds(BitReader* readers, unsigned char* out, size_t rounds) const;
+};
+
+#endif
@@ -1,43 +1,181 @@
+#include "Container.hpp"
+#include "DecodeTable.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "OutputFile.hpp"
+#include "OutputBuffer.hpp"
+#include "Pipeline.hpp"
+#include "SyncIndex.hpp"
 #include <cstddef>
+#include <cstdint>
+#include <fstream>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
+// Node of the flattened decoding tree.
+// Children are indices in the same array, root is always at index 0,
+// so 0 doubles as "no child"
 struct Node{
-    Node(char c = '\0', bool leaf = false) : symbol(c), is_leaf(leaf){}
-    char symbol;
-    std::unique_ptr<Node> left = nullptr;
-    std::unique_ptr<Node> right = nullptr;
-    bool is_leaf;
+    static constexpr uint16_t NIL = 0;
+
+    uint16_t child[2] = {NIL, NIL}; // [0] - bit 0, [1] - bit 1
+    char symbol = '\0';
+    bool is_leaf = false;
 };
 
+// Input path "-" reads stdin, output path "-" writes decoded bytes to stdout
 class Decoder{
 public:
+    // Tree - walk the code tree bit by bit
+    // Table - multi-bit lookup tables, several symbols per lookup
+    enum class Method{
+        Tree,
+        Table
+    };
+
     Decoder(std::string input_path_text, std::string input_path_alphabet,
-    std::string output_path = "encoded.txt")
+    std::string output_path = "encoded.txt", Method method = Method::Table)
         : input_path_text_(input_path_text),
-        input_path_alphabet_(input_path_alphabet), output_path_(output_path) {}
+        input_path_alphabet_(input_path_alphabet), output_path_(output_path),
+        method_(method) { OutputFile::reserve_stdout(output_path_); }
 
     void start();
 
+    // Threads for decoding blocks and indexed streams, 0 - one per hardware thread
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // Blocked container file into a file: read, decode and write blocks on separate
+    // stages, so that I/O overlaps decoding. Other inputs decode as usual
+    void set_pipeline(bool pipeline) { pipeline_ = pipeline; }
+    void set_pipeline_io(Pipeline::Io io) { pipeline_io_ = io; }
+
+    // First bytes of stdin, when the caller already read them to tell the engine
+    void set_stdin_head(std::vector<uint8_t> head) { stdin_head_ = std::move(head); }
+
+    // Print the first decoded symbols to stdout when done, on by default
+    void set_preview(bool preview) { preview_ = preview; }
+
+    // Write metrics of every run as JSON to this file, empty - do not write
+    void set_metrics_path(std::string path) { metrics_path_ = std::move(path); }
+
+    // Phase timings and sizes of the last start()
+    const Metrics& metrics() const { return metrics_; }
+
+    // Decode bytes [begin, end) of the original file, starting every
+    // stream it touches at the nearest sync point when an index is present
+    std::vector<unsigned char> decode_range(uint64_t begin, uint64_t end);
+
     static unsigned char parse_symbol_token(const std::string &token_raw);
+
+    // Decoding tree of codes (symbol, code string of '0'/'1'), in any order
+    static std::vector<Node> build_tree(std::vector<std::pair<unsigned char, std::string>> codes);
+
+    // Walk tree bit by bit over payload, the last byte with padding unused low bits
+    static void tree_walk(const std::vector<Node>& tree, std::span<const uint8_t> payload,
+    unsigned padding, OutputBuffer& output);
 private:
     std::string input_path_text_;
     std::string input_path_alphabet_;
     std::string output_path_;
-    std::unique_ptr<Node> tree_;
+    Method method_;
+    MappedFile input_;
+    std::optional<std::vector<uint8_t>> stdin_head_;
+    unsigned threads_ = 0;
+    bool pipeline_ = false;
+    Pipeline::Io pipeline_io_ = Pipeline::Io::Auto;
+    Metrics metrics_;
+    std::string metrics_path_;
+    // All nodes of the decoding tree in one allocation
+    std::vector<Node> tree_;
+    // Part of the input coded with one table: the legacy stream or a container block
+    struct Stream{
+        const uint8_t* payload = nullptr;
+        size_t bytes = 0;
+        uint64_t bit_count = 0;
+        uint64_t symbols = 0;
+        bool symbols_known = false;   // always for blocks, for the legacy stream with an index
+        uint64_t output_offset = 0;   // first symbol of the stream in the original file
+        std::shared_ptr<const DecodeTable> table;
+        SyncIndex index;
+        std::vector<Container::Lane> lanes;   // interleaved block, offsets from payload
+    };
+
+    // Sync points [first, last) of a stream, whole stream when it has no index
+    struct Range{
+        size_t stream;
+        size_t first;
+        size_t last;
+    };
+
+    std::vector<Stream> streams_;
 
     int cout_number = 10;
 
+    bool preview_ = true;
+
     std::vector<std::pair<unsigned char, std::string>> match_vec_;
 
     void read_alphabet(std::ifstream& input_file);
 
-    std::unique_ptr<Node> make_tree(size_t beg, size_t end, size_t rang);
+    // Number of nodes make_tree will create: distinct prefixes of the sorted codes
+    static size_t count_tree_nodes(const std::vector<std::pair<unsigned char, std::string>>& codes);
+
+    // Append subtree for sorted codes[beg..end] to tree, returns its index
+    static uint16_t make_tree(const std::vector<std::pair<unsigned char, std::string>>& codes, std::vector<Node>& tree,
+    size_t beg, size_t end, size_t rang);
 
-    size_t find_med(size_t beg, size_t end, size_t rang);
+    static size_t find_med(const std::vector<std::pair<unsigned char, std::string>>& codes, size_t beg, size_t end, size_t rang);
 
     void decode_text(std::ifstream& input_file);
 
     void bit_decode();
+
+    // Decode every stream with the lookup tables, in parallel when there is more than one range
+    void table_decode();
+
+    // Decode a container from stdin without holding it in memory, head - its first bytes
+    void stream_decode(std::vector<uint8_t> head);
+
+    // Map the input and describe its streams: container blocks or the legacy stream with its alphabet
+    void load();
+
+    // Legacy input: read alphabet and sync index, build the table
+    void load_stream();
+
+    // Container input: code table, payload and index of every block
+    void load_container();
+
+    // Whether the input can be decoded on a Pipeline: a blocked Fano container in a file, output to a file
+    bool can_pipeline() const;
+
+    // Decode block by block on a Pipeline, each block read whole into a buffer
+    void pipeline_decode();
+
+    // Stream of a block, block - its first byte, size - bytes from there to the end of the input
+    static Stream block_stream(const uint8_t* block, size_t size, const Container::BlockEntry& entry,
+    const Container::Header& header);
+
+    // Decode a whole stream into out, throws unless it decodes to exactly its symbols
+    static void decode_whole(const Stream& stream, unsigned char* out);
+
+    // Decode a whole stream or sync points [first, last) of it, last == points.size() - to the end
+    std::vector<unsigned char> decode_part(const Range& range) const;
+
+    // Parts of all streams, a few sync points per task
+    std::vector<Range> make_ranges(size_t tasks) const;
+
+    // Decode all ranges on a thread pool, writing them in order
+    void parallel_decode(OutputFile& output);
+
+    static BitReader stream_reader(const Stream& stream);
+
+    // Readers of the lanes of an interleaved stream
+    static std::vector<BitReader> lane_readers(const Stream& stream);
+
+    // First count symbols of an interleaved stream, with every lane read to its end when count is all of them
+    static void decode_lanes(const Stream& stream, unsigned char* out, size_t count);
 };
\ No newline at end of file
@@ -1,42 +1,144 @@
+#include "BitWriter.hpp"
+#include "FanoTable.hpp"
+#include "Histogram.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "OutputFile.hpp"
+#include "Pipeline.hpp"
+#include "SyncIndex.hpp"
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
+// Input path "-" reads stdin, output path "-" writes the container to stdout
 class Encoder{
 public:
     Encoder(std::string input_path, std::string output_path_text = "encoded.bin",
     std::string output_path_alphabet = "encoded_alphabet.txt")
         : input_path_(input_path), output_path_text_(output_path_text),
-        output_path_alphabet_(output_path_alphabet) {}
+        output_path_alphabet_(output_path_alphabet) { OutputFile::reserve_stdout(output_path_text_); }
 
     void start();
 
+    // Threads for the frequency pass and block encoding, 0 - one per hardware thread
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // Cut the input into blocks of this many bytes, each with its own code table,
+    // and write them into one container. 0 - whole input as a single stream
+    void set_block_size(size_t block_size) { block_size_ = block_size; }
+
+    // Record a sync point every `symbols` symbols of every stream, 0 - no index.
+    // The index goes into the container, or next to the alphabet for the legacy format
+    void set_sync_interval(uint64_t symbols) { sync_interval_ = symbols; }
+
+    // Longest code of any table, 0 - not limited, at most FanoTable::MAX_LENGTH_LIMIT.
+    // The limit is recorded in the container
+    void set_max_code_length(unsigned bits) { max_code_length_ = bits; }
+
+    // Deal the symbols of every block round-robin over this many bitstreams, 1 (default), 2, 4 or 8.
+    // The decoder advances all of them in one loop, so the lookups of one step overlap.
+    // Container only, not together with a sync index
+    void set_streams(unsigned streams) { streams_ = streams; }
+
+    // Write a single container file with the code table inside (default),
+    // false - legacy payload file with a separate text alphabet
+    void set_container(bool container) { container_ = container; }
+
+    // Blocked encoding of a file into a file: read, code and write blocks on separate
+    // stages, so that I/O overlaps coding. Other jobs encode as usual
+    void set_pipeline(bool pipeline) { pipeline_ = pipeline; }
+    void set_pipeline_io(Pipeline::Io io) { pipeline_io_ = io; }
+
+    // Print the first codes to stdout while encoding, on by default
+    void set_preview(bool preview) { preview_ = preview; }
+
+    // Write metrics of every run as JSON to this file, empty - do not write
+    void set_metrics_path(std::string path) { metrics_path_ = std::move(path); }
+
+    // Phase timings and sizes of the last start()
+    const Metrics& metrics() const { return metrics_; }
+
     //void convert_to_binary();
 
     static std::string format_symbol(unsigned char c);
+
+    // Encode data with codes into writer, recording a sync point every interval symbols
+    static void encode_span(std::span<const uint8_t> data, const std::array<Code, 256>& codes,
+    BitWriter& writer, uint64_t interval, SyncIndex& index);
+
+    // Bits of every lane when data is dealt round-robin over streams lanes
+    static std::vector<uint64_t> lane_bits(std::span<const uint8_t> data, const std::array<Code, 256>& codes,
+    unsigned streams);
+
+    // Interleaved payload of data: lane lengths, then the lanes padded to whole bytes.
+    // writer must be on a byte boundary, bits - lane_bits() of data
+    static void encode_interleaved(std::span<const uint8_t> data, const std::array<Code, 256>& codes,
+    BitWriter& writer, const std::vector<uint64_t>& bits);
 private:
     std::string input_path_;
     std::string output_path_text_;
     std::string output_path_alphabet_;
-    std::array<std::string, 256> dict_{};
-    std::array<unsigned, 256> frec_dict_{};
-    std::vector<std::pair<unsigned char, double>> prob_vec_;
+    // Input bytes shared by the frequency and the encoding pass
+    MappedFile input_;
+    FanoTable table_;
+    FanoTable::Counts frec_dict_{};
 
     int cout_number = 10;
 
-    void compute_prob();
+    unsigned threads_ = 0;
+
+    size_t block_size_ = 0;
 
-    unsigned compute_frec();
+    uint64_t sync_interval_ = 0;
 
-    void fill_dict(size_t beg, size_t end);
+    unsigned max_code_length_ = 0;
 
-    size_t find_med(size_t beg, size_t end);
+    unsigned streams_ = 1;
+
+    bool container_ = true;
+
+    bool preview_ = true;
+
+    bool pipeline_ = false;
+
+    Pipeline::Io pipeline_io_ = Pipeline::Io::Auto;
+
+    Metrics metrics_;
+    std::string metrics_path_;
+
+    // Throws for stream counts the options do not allow
+    void check_streams() const;
+
+    void compute_prob();
+
+    uint64_t compute_frec();
 
     void text_encode();
 
     void write_alphabet(std::ofstream& output_file);
 
     void bit_encode();
+
+    // Encode input_ as a single block of a container, streaming the payload
+    void container_encode();
+
+    // Encode input_ block by block on a thread pool into a container
+    void block_encode();
+
+    // Whether the job can run on a Pipeline: file to file and blocked
+    bool can_pipeline() const;
+
+    // Encode block by block on a Pipeline, the same container block_encode() writes
+    void pipeline_encode();
+
+    // Code table and body of a block as block_encode() writes them, appended to out.
+    // Returns payload bits, counts - symbols of the block
+    uint64_t encode_block(std::span<const uint8_t> data, std::vector<uint8_t>& out, Histogram::Counts& counts) const;
+
+    void print_preview(std::span<const uint8_t> data, const std::array<Code, 256>& codes) const;
 };
\ No newline at end of file
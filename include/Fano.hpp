@@ -0,0 +1,94 @@
+#ifndef FANO_HPP
+#define FANO_HPP
+
+#include "Code.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// In-memory API of the engines.
+// Everything takes and returns memory, no file is touched. Encoded buffers are
+// the same containers the file engines write, so a buffer from fano::encode()
+// can be saved and decoded by Decoder/UniDecoder, and files written by
+// Encoder/UniEncoder can be decoded with fano::decode()
+namespace fano{
+
+enum class Engine{
+    Fano,
+    Uniform
+};
+
+// Code of every byte value, a value type that can be stored, compared and reused
+class CodeTable{
+public:
+    CodeTable() = default;
+    CodeTable(Engine engine, const std::array<Code, 256>& codes) : engine_(engine), codes_(codes) {}
+
+    // Table for the byte frequencies of data, max_code_length - longest Fano code, 0 - not limited
+    static CodeTable build(std::span<const std::byte> data, Engine engine = Engine::Fano, unsigned max_code_length = 0);
+
+    Engine engine() const { return engine_; }
+    const std::array<Code, 256>& codes() const { return codes_; }
+    const Code& operator[](unsigned char symbol) const { return codes_[symbol]; }
+
+    // Number of symbols with a code
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    // Length in bits of data once encoded, throws if data has a symbol without a code
+    uint64_t encoded_bits(std::span<const std::byte> data) const;
+
+    // Container code table format: u16 count, (symbol, length) pairs, packed codes
+    std::vector<std::byte> serialize() const;
+    // Returns the table, used - bytes it took in data
+    static CodeTable deserialize(std::span<const std::byte> data, Engine engine = Engine::Fano, size_t* used = nullptr);
+
+    friend bool operator==(const CodeTable& a, const CodeTable& b);
+
+private:
+    Engine engine_ = Engine::Fano;
+    std::array<Code, 256> codes_{};
+};
+
+struct EncodeOptions{
+    Engine engine = Engine::Fano;
+    // Bytes per block, each with its own code table, 0 - whole input as a single block
+    size_t block_size = 0;
+    // Sync point every this many symbols for range and parallel decoding, 0 - no index. Fano only
+    uint64_t sync_interval = 0;
+    // Longest code of any table, 0 - not limited, at most 32. Fano only
+    unsigned max_code_length = 0;
+    // Bitstreams per block the symbols are dealt round-robin over, 1, 2, 4 or 8.
+    // More than one lets the decoder overlap their lookups. Fano only, not with a sync index
+    unsigned streams = 1;
+    // Threads for blocks, 0 - one per hardware thread
+    unsigned threads = 1;
+};
+
+// Encode data into a new container
+std::vector<std::byte> encode(std::span<const std::byte> data, const EncodeOptions& options = {});
+
+// Encode data with a given table as a single block, the table must cover every byte of data
+std::vector<std::byte> encode(std::span<const std::byte> data, const CodeTable& table, uint64_t sync_interval = 0);
+
+// Encode into out, returns bytes written. Throws if out is smaller than the container,
+// max_encoded_size() bytes are always enough
+size_t encode(std::span<const std::byte> data, std::span<std::byte> out, const EncodeOptions& options = {});
+
+// Upper bound of the container size for size input bytes
+size_t max_encoded_size(size_t size, const EncodeOptions& options = {});
+
+// Original size recorded in a container
+uint64_t decoded_size(std::span<const std::byte> container);
+
+// Decode a container of either engine
+std::vector<std::byte> decode(std::span<const std::byte> container, unsigned threads = 1);
+
+// Decode into out, returns bytes written. Throws if out is smaller than decoded_size()
+size_t decode(std::span<const std::byte> container, std::span<std::byte> out, unsigned threads = 1);
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef FANOTABLE_HPP
+#define FANOTABLE_HPP
+
+#include "Code.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Shannon-Fano code built from symbol frequencies.
+// Symbols are sorted by count and the range is recursively split where the
+// two halves are closest in total count. Counts are compared as 64-bit
+// integers and ties are ordered by symbol, so the codes are exact for any
+// input size and the same on every platform.
+// When a Fano code is longer than the length limit, the lengths are replaced by
+// the best ones within the limit (package-merge) and the codes are reassigned in
+// count order, which again splits the sorted symbols into ranges recursively
+class FanoTable{
+public:
+    using Counts = std::array<uint64_t, 256>;
+
+    static constexpr unsigned MAX_LENGTH_LIMIT = 32;
+
+    FanoTable() = default;
+    // max_length - longest code allowed, 0 - not limited
+    explicit FanoTable(const Counts& counts, unsigned max_length = 0) { build(counts, max_length); }
+
+    // Throws if more than 2^max_length symbols occur or max_length is above MAX_LENGTH_LIMIT
+    void build(const Counts& counts, unsigned max_length = 0);
+
+    bool empty() const { return count_vec_.empty(); }
+
+    // Number of symbols with a code
+    size_t size() const { return count_vec_.size(); }
+
+    const Code& operator[](unsigned char symbol) const { return dict_[symbol]; }
+    const std::array<Code, 256>& codes() const { return dict_; }
+
+    // Length in bits of the data the counts were taken from, once encoded
+    uint64_t encoded_bits(const Counts& counts) const;
+
+private:
+    std::array<Code, 256> dict_{};
+    // Symbols with their counts, most frequent first
+    std::vector<std::pair<unsigned char, uint64_t>> count_vec_;
+    // prefix_[i] - total count of count_vec_[0..i)
+    std::vector<uint64_t> prefix_;
+    unsigned max_length_ = 0;
+
+    void fill_dict(size_t beg, size_t end);
+
+    // First symbol of the right half of [beg, end], binary search over prefix_
+    size_t find_med(size_t beg, size_t end) const;
+
+    // Rebuild the codes with none longer than max_length_
+    void limit_lengths();
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include "ThreadPool.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+// Byte frequency counter.
+// The input is split into one chunk per thread, every chunk is counted into
+// several interleaved sub-histograms so that runs of the same byte do not
+// serialize on one counter, and the partial results are summed at the end
+class Histogram{
+public:
+    using Counts = std::array<uint64_t, 256>;
+
+    // Inputs shorter than this per thread are counted on the calling thread
+    static constexpr size_t MIN_CHUNK = size_t{1} << 20;
+
+    // threads == 0 - one per hardware thread
+    explicit Histogram(unsigned threads = 0);
+
+    Counts count(std::span<const uint8_t> data);
+
+    // Single-threaded count, same result as count()
+    static Counts count_serial(std::span<const uint8_t> data);
+
+    unsigned threads() const { return threads_; }
+
+private:
+    unsigned threads_;
+
+    // Created on first input large enough to split
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+#endif
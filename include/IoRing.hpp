@@ -0,0 +1,69 @@
+#ifndef IORING_HPP
+#define IORING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimal io_uring for positional reads and writes of the pipeline stages.
+// Talks to the kernel through the raw system calls, so it needs only the
+// Linux headers. Built when FANO_IO_URING is defined and <linux/io_uring.h>
+// exists, supported() also checks that the kernel lets us set a ring up
+class IoRing{
+public:
+    struct Completion{
+        uint64_t tag = 0;
+        int64_t result = 0;     // bytes transferred or -errno
+    };
+
+    // Largest request, longer transfers are split by the caller on short results
+    static constexpr size_t MAX_REQUEST = size_t{1} << 30;
+
+    static bool supported();
+
+    // Ring for up to entries requests in flight, throws if it can not be set up
+    explicit IoRing(unsigned entries);
+    ~IoRing();
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // Submit a request. Throws when entries requests are already in flight
+    void read(int fd, uint8_t* data, size_t size, uint64_t offset, uint64_t tag);
+    void write(int fd, const uint8_t* data, size_t size, uint64_t offset, uint64_t tag);
+
+    // Wait for one of the requests to complete
+    Completion wait();
+
+    // Requests not completed yet
+    unsigned pending() const { return queued_ + in_flight_; }
+
+private:
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    unsigned queued_ = 0;
+    unsigned in_flight_ = 0;
+
+    // Mapped rings
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    void* cqes_ = nullptr;
+
+    void queue(uint8_t opcode, int fd, const uint8_t* data, size_t size, uint64_t offset, uint64_t tag);
+    // Submit queued requests, waiting for complete completions
+    void enter(unsigned complete);
+    void release();
+};
+
+#endif
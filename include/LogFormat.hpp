@@ -0,0 +1,68 @@
+#ifndef LOGFORMAT_HPP
+#define LOGFORMAT_HPP
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Minimal "{}" formatter for log messages.
+// Every "{}" is replaced by the next argument, "{{" and "}}" print single braces.
+// Arguments are strings, chars, bools, numbers (uint8_t prints as a number)
+// or objects with a to_string() member
+namespace LogFormat{
+
+inline void append(std::string& out, std::string_view value) { out.append(value); }
+inline void append(std::string& out, const std::string& value) { out.append(value); }
+inline void append(std::string& out, const char* value) { out.append(value); }
+inline void append(std::string& out, char value) { out.push_back(value); }
+inline void append(std::string& out, bool value) { out.append(value ? "true" : "false"); }
+
+template<typename T>
+    requires (std::integral<T> || std::floating_point<T>)
+void append(std::string& out, T value){
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+template<typename T>
+    requires requires(const T& value) { { value.to_string() } -> std::convertible_to<std::string>; }
+void append(std::string& out, const T& value){
+    out.append(value.to_string());
+}
+
+// Copy fmt from pos up to the next "{}" and move pos past it, false when fmt ends first
+inline bool copy_literal(std::string& out, std::string_view fmt, size_t& pos){
+    while(pos < fmt.size()){
+        const char c = fmt[pos];
+        const bool has_next = pos + 1 < fmt.size();
+        if(has_next && (c == '{' || c == '}') && fmt[pos + 1] == c){
+            out.push_back(c);
+            pos += 2;
+            continue;
+        }
+        if(has_next && c == '{' && fmt[pos + 1] == '}'){
+            pos += 2;
+            return true;
+        }
+        out.push_back(c);
+        ++pos;
+    }
+    return false;
+}
+
+template<typename... Args>
+void format_to(std::string& out, std::string_view fmt, const Args&... args){
+    size_t pos = 0;
+    ((copy_literal(out, fmt, pos), append(out, args)), ...);
+    // Placeholders without an argument are printed as is
+    while(copy_literal(out, fmt, pos)){
+        out.append("{}");
+    }
+}
+
+} // namespace LogFormat
+
+#endif
@@ -1,18 +1,63 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include "LogFormat.hpp"
+#include "RingBuffer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <fstream>
+#include <thread>
+
+// Lowest level compiled in, statements below it compile to nothing.
+// 0 - DEBUG, 1 - INFO, 2 - WARNING, 3 - ERROR; release builds (NDEBUG) drop DEBUG
+#ifndef FANO_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define FANO_LOG_MIN_LEVEL 1
+#else
+#define FANO_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// Lazy log statements: neither the arguments are evaluated nor the message is
+// formatted unless the level is compiled in and enabled at run time.
+// LOG_DEBUG("Found median: {} for range [{}-{}]", "FanoTable::find_med", med, beg, end);
+#define FANO_LOG_AT(level, fmt, component, ...)                                              \
+    do {                                                                                     \
+        if constexpr (Logger::compiled(level)) {                                             \
+            if (Logger::getInstance().enabled(level)) {                                      \
+                Logger::getInstance().write(level, component, fmt __VA_OPT__(,) __VA_ARGS__); \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
+
+#define LOG_DEBUG(fmt, component, ...) FANO_LOG_AT(Logger::Level::DEBUG, fmt, component __VA_OPT__(,) __VA_ARGS__)
+#define LOG_INFO(fmt, component, ...) FANO_LOG_AT(Logger::Level::INFO, fmt, component __VA_OPT__(,) __VA_ARGS__)
+#define LOG_WARNING(fmt, component, ...) FANO_LOG_AT(Logger::Level::WARNING, fmt, component __VA_OPT__(,) __VA_ARGS__)
+#define LOG_ERROR(fmt, component, ...) FANO_LOG_AT(Logger::Level::ERROR, fmt, component __VA_OPT__(,) __VA_ARGS__)
 
 class Logger {
 public:
+    // Ordered by severity, messages below the current level are skipped
     enum class Level {
+        DEBUG,
         INFO,
         WARNING,
-        ERROR,
-        DEBUG
+        ERROR
+    };
+
+    // What a producer does when the async queue is full
+    enum class FullPolicy {
+        Drop,   // discard the record, the writer reports how many were lost
+        Block   // wait for the writer to free a slot
     };
 
+    static constexpr size_t DEFAULT_QUEUE_SIZE = 8192;
+
     static Logger& getInstance();
 
     void info(const std::string& message, const std::string& component = "");
@@ -20,27 +65,73 @@ public:
     void error(const std::string& message, const std::string& component = "");
     void debug(const std::string& message, const std::string& component = "");
 
+    static constexpr bool compiled(Level level) { return static_cast<int>(level) >= FANO_LOG_MIN_LEVEL; }
+    bool enabled(Level level) const { return level >= currentLevel_.load(std::memory_order_relaxed); }
+
+    // Format fmt with args and log it, callers check enabled() first (see LOG_DEBUG)
+    template<typename... Args>
+    void write(Level level, std::string_view component, std::string_view fmt, const Args&... args) {
+        std::string message;
+        message.reserve(fmt.size() + 16 * sizeof...(Args));
+        LogFormat::format_to(message, fmt, args...);
+        log(level, message, std::string(component));
+    }
+
     void setLogLevel(Level level);
     void setLogToFile(bool enable);
     void setLogToConsole(bool enable);
+    // Send every console entry to stderr, keeps stdout free for data
+    void setLogToStderr(bool enable);
     void setLogFile(const std::string& filename);
 
+    // Hand formatted records to a background thread which writes them in batches.
+    // Switch only while no other thread is logging
+    void setAsync(bool enable, size_t queue_size = DEFAULT_QUEUE_SIZE, FullPolicy policy = FullPolicy::Block);
+
+    // Wait until every record queued so far is written
+    void flush();
+
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
 private:
+    struct Record {
+        Level level = Level::INFO;
+        std::string text;
+    };
+
     Logger();
     ~Logger();
 
     std::ofstream logFile_;
     std::string logFilePath_;
-    Level currentLevel_ = Level::INFO;
+    std::atomic<Level> currentLevel_{Level::INFO};
     bool logToFile_ = false;
     bool logToConsole_ = true;
+    bool logToStderr_ = false;
+
+    // Guards the sinks above against the writer thread
+    std::mutex sinkMutex_;
+
+    // Async mode
+    std::unique_ptr<RingBuffer<Record>> queue_;
+    std::thread writer_;
+    FullPolicy policy_ = FullPolicy::Block;
+    std::atomic<bool> async_{false};
+    std::atomic<bool> stop_{false};
+    // Bumped on every push, the writer sleeps on it when the queue is empty
+    std::atomic<uint32_t> wake_{0};
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
 
     std::string getCurrentTime();
     std::string levelToString(Level level);
     void log(Level level, const std::string& message, const std::string& component);
+
+    void push(Record& record);
+    void writerLoop();
+    void stopWriter();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,56 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <string>
+
+// Read-only view of a whole input file, STDIN_PATH reads standard input.
+// Regular files are memory-mapped, otherwise (pipes, platforms without mmap,
+// failed mapping) the file is read in large aligned blocks into an owned buffer.
+// Either way every pass over the input runs over the same bytes
+class MappedFile{
+public:
+    static constexpr size_t BLOCK_SIZE = size_t{1} << 20;
+    static constexpr size_t ALIGNMENT = 4096;
+    static constexpr const char* STDIN_PATH = "-";
+
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    void open(const std::string& path);
+    // Read the rest of input, head - its first bytes already taken by the caller
+    void open(std::istream& input, std::span<const uint8_t> head, const std::string& name);
+    void close();
+
+    bool is_open() const { return open_; }
+    bool is_mapped() const { return mapped_; }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::span<const uint8_t> bytes() const { return {data_, size_}; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+    bool mapped_ = false;
+
+    // Owned buffer when the file is read instead of mapped
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+
+    bool map(const std::string& path);
+    void read_blocks(std::istream& input, const std::string& path);
+    void reserve(size_t capacity);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <string>
+#include <vector>
+
+// Timing and size figures of one encode or decode run.
+// Engines fill it during start(), phases keep the order they first ran in
+struct Metrics{
+    struct Phase{
+        std::string name;
+        double seconds = 0;
+    };
+
+    std::string engine;     // "fano" or "uniform"
+    std::string operation;  // "encode" or "decode"
+    std::string input;      // file the run read, empty - not recorded
+    std::vector<Phase> phases;
+    double total_seconds = 0;
+
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t symbols = 0;       // bytes of the original file
+    uint64_t payload_bits = 0;  // coded bits of all streams
+
+    // Shannon entropy of the input in bits per symbol, known when encoding
+    std::optional<double> entropy;
+
+    void add_phase(const std::string& name, double seconds);
+
+    // Bits per symbol of the payload
+    double average_code_length() const;
+
+    // Original bytes per second of total time, in MB/s (10^6 bytes)
+    double throughput_mbps() const;
+
+    std::string to_json() const;
+    void write_json(const std::string& path) const;
+
+    static double entropy_of(const std::array<uint64_t, 256>& counts);
+};
+
+// Adds the wall time of its scope to one phase of metrics
+class PhaseTimer{
+public:
+    PhaseTimer(Metrics& metrics, std::string name)
+        : metrics_(metrics), name_(std::move(name)), start_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() { stop(); }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    // End the phase before the scope does
+    void stop(){
+        if(stopped_) return;
+        stopped_ = true;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        metrics_.add_phase(name_, elapsed.count());
+    }
+
+private:
+    Metrics& metrics_;
+    std::string name_;
+    std::chrono::steady_clock::time_point start_;
+    bool stopped_ = false;
+};
+
+#endif
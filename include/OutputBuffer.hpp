@@ -0,0 +1,50 @@
+#ifndef OUTPUTBUFFER_HPP
+#define OUTPUTBUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Buffered sink for decoded bytes.
+// Bytes are stored into a large reusable buffer which is written to the stream
+// in bulk. The first preview_size bytes are kept for the console preview
+class OutputBuffer{
+public:
+    static constexpr size_t DEFAULT_SIZE = size_t{1} << 20;
+
+    explicit OutputBuffer(std::ostream& output, size_t preview_size = 0, size_t size = DEFAULT_SIZE);
+
+    void put(unsigned char c){
+        if(pos_ == buffer_.size()){
+            flush();
+        }
+        buffer_[pos_++] = c;
+    }
+
+    // Free space for bulk writers: write up to available() bytes at tail(), then commit()
+    unsigned char* tail() { return buffer_.data() + pos_; }
+    size_t available() const { return buffer_.size() - pos_; }
+    void commit(size_t n) { pos_ += n; }
+
+    // Write buffered bytes to the stream
+    void flush();
+
+    // Bytes passed through the buffer so far
+    uint64_t total() const { return flushed_ + pos_; }
+
+    // First bytes of the output, complete after flush()
+    const std::string& preview() const { return preview_; }
+
+private:
+    std::ostream& output_;
+    std::vector<unsigned char> buffer_;
+    size_t pos_ = 0;
+    uint64_t flushed_ = 0;
+
+    size_t preview_size_;
+    std::string preview_;
+};
+
+#endif
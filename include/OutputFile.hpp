@@ -0,0 +1,40 @@
+#ifndef OUTPUTFILE_HPP
+#define OUTPUTFILE_HPP
+
+#include <fstream>
+#include <ostream>
+#include <string>
+
+// Destination of encoded or decoded bytes: a file, or standard output for STDOUT_PATH.
+// Standard output may be a pipe or a socket, so only formats written front to back go there
+class OutputFile{
+public:
+    static constexpr const char* STDOUT_PATH = "-";
+
+    OutputFile() = default;
+    explicit OutputFile(const std::string& path) { open(path); }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    void open(const std::string& path);
+
+    // Flush buffered bytes, throws if any write failed
+    void flush();
+
+    std::ostream& stream() { return *stream_; }
+    bool is_stdout() const { return stream_ != nullptr && stream_ != &file_; }
+
+    static bool is_stdout_path(const std::string& path) { return path == STDOUT_PATH; }
+
+    // Send log lines to stderr if path is stdout. Engines call it when they are
+    // constructed, since they log before the output is opened
+    static void reserve_stdout(const std::string& path);
+
+private:
+    std::ofstream file_;
+    std::ostream* stream_ = nullptr;
+    std::string path_;
+};
+
+#endif
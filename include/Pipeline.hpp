@@ -0,0 +1,114 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "PositionalFile.hpp"
+#include "SpscQueue.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read / code / write pipeline for file to file jobs.
+// A reader thread fills input buffers with parts of the input, the caller's
+// thread codes each full buffer into an output buffer, and a writer thread
+// writes that at the offset the coder chose. Stages are linked by bounded
+// SPSC queues, and empty buffers go back to the stage that fills them, so
+// depth buffers per link are allocated once and reused. With depth 2 the
+// reader fills one buffer while the coder works on the other.
+// Reads and writes go through io_uring where it is built in and allowed,
+// so a stage keeps up to depth requests in flight. Otherwise each stage is
+// a thread doing pread / pwrite
+class Pipeline{
+public:
+    enum class Io{
+        Auto,       // io_uring when supported, threads otherwise
+        Threads,
+        IoUring
+    };
+
+    static constexpr size_t DEFAULT_DEPTH = 2;
+
+    // Part of the input read into one buffer
+    struct Range{
+        uint64_t offset = 0;
+        size_t size = 0;
+    };
+
+    struct Buffer{
+        std::vector<uint8_t> data;
+        uint64_t offset = 0;    // input offset of a read buffer, output offset of a coded one
+        size_t index = 0;       // number of the range it was read for
+    };
+
+    // Codes in, a whole range, into out, setting the output offset of out.
+    // An empty out writes nothing
+    using Coder = std::function<void(const Buffer& in, Buffer& out)>;
+
+    // Both files are positional, so no other process can be a pipe. POSIX only
+    static bool supported();
+
+    static const char* name(Io io);
+
+    // Opens input and creates output of output_size bytes, written to or past it
+    Pipeline(const std::string& input_path, const std::string& output_path, uint64_t output_size = 0,
+    Io io = Io::Auto, size_t depth = DEFAULT_DEPTH);
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // Read ranges in order and code each of them on this thread. Rethrows the first error of any stage
+    void run(const std::vector<Range>& ranges, const Coder& coder);
+
+    // Write data at offset after run(), for headers known only at the end
+    void write_at(uint64_t offset, const uint8_t* data, size_t size);
+
+    // Close the output, throws if closing fails
+    void close();
+
+    // I/O in use, never Auto
+    Io io() const { return io_; }
+
+    // Seconds the reader and the writer spent waiting for I/O, and the coder for input
+    double read_seconds() const { return read_seconds_; }
+    double write_seconds() const { return write_seconds_; }
+    double stall_seconds() const { return stall_seconds_; }
+
+private:
+    std::string input_path_;
+    std::string output_path_;
+    int input_fd_ = -1;
+    PositionalFile output_;
+    Io io_;
+    size_t depth_;
+
+    double read_seconds_ = 0;
+    double write_seconds_ = 0;
+    double stall_seconds_ = 0;
+
+    // Full buffers go forward, empty ones back
+    std::unique_ptr<SpscQueue<Buffer>> read_full_;
+    std::unique_ptr<SpscQueue<Buffer>> read_free_;
+    std::unique_ptr<SpscQueue<Buffer>> write_full_;
+    std::unique_ptr<SpscQueue<Buffer>> write_free_;
+
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+
+    // Record the first error and close every queue, so no stage waits for another forever
+    void fail(std::exception_ptr error);
+
+    void read_threads(const std::vector<Range>& ranges);
+    void read_ring(const std::vector<Range>& ranges);
+    void write_threads();
+    void write_ring();
+
+    // Read size bytes at offset, throws on errors and on a file shorter than that
+    void read_at(uint64_t offset, uint8_t* data, size_t size);
+};
+
+#endif
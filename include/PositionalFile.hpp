@@ -0,0 +1,37 @@
+#ifndef POSITIONALFILE_HPP
+#define POSITIONALFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// Output file of a known size written at any offset, from several threads at once.
+// Uses pwrite where the platform has it, otherwise one stream seeked under a lock
+class PositionalFile{
+public:
+    // Create or truncate path and size it to size bytes
+    PositionalFile(const std::string& path, uint64_t size);
+    ~PositionalFile();
+
+    PositionalFile(const PositionalFile&) = delete;
+    PositionalFile& operator=(const PositionalFile&) = delete;
+
+    // Write size bytes of data at offset, throws if the write fails
+    void write_at(uint64_t offset, const uint8_t* data, size_t size);
+
+    // Close the file, throws if closing fails
+    void close();
+
+    // Descriptor for asynchronous writes, -1 where pwrite is not used
+    int handle() const { return fd_; }
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    std::ofstream file_;
+    std::mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef RINGBUFFER_HPP
+#define RINGBUFFER_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue for many producers and consumers.
+// Every cell carries a sequence number telling whether it is free for the
+// producer of this lap or holds a value for the consumer of this lap.
+// Capacity is rounded up to a power of two
+template<typename T>
+class RingBuffer{
+public:
+    explicit RingBuffer(size_t capacity)
+        : capacity_(std::bit_ceil(capacity < 2 ? size_t{2} : capacity)),
+        mask_(capacity_ - 1), cells_(std::make_unique<Cell[]>(capacity_)){
+        for(size_t i = 0; i < capacity_; ++i){
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Returns false without touching value when the buffer is full
+    bool try_push(T& value){
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while(true){
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if(diff == 0){
+                if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0){
+                return false;
+            }
+            else{
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false when the buffer is empty
+    bool try_pop(T& value){
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while(true){
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if(diff == 0){
+                if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0){
+                return false;
+            }
+            else{
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct Cell{
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    size_t capacity_;
+    size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // Producers and the consumer touch different lines
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif
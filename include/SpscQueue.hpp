@@ -0,0 +1,92 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded queue between two pipeline stages: one thread pushes, one pops.
+// Each side owns one index, so neither locks while the other has room.
+// A side blocks only while the queue is full or empty, waiting on a counter
+// every push, pop and close() bumps. After close() push() drops values and
+// pop() returns false once the queue is drained
+template<typename T>
+class SpscQueue{
+public:
+    explicit SpscQueue(size_t capacity)
+        : capacity_(capacity < 1 ? 1 : capacity), cells_(std::make_unique<T[]>(capacity_)) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Waits for room, returns false without taking value if the queue is closed
+    bool push(T& value){
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        while(true){
+            const uint32_t seen = events_.load(std::memory_order_acquire);
+            if(closed_.load(std::memory_order_acquire)){
+                return false;
+            }
+            if(tail - head_.load(std::memory_order_acquire) < capacity_){
+                break;
+            }
+            events_.wait(seen, std::memory_order_acquire);
+        }
+        cells_[tail % capacity_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    // Waits for a value, returns false once the queue is closed and empty
+    bool pop(T& value){
+        while(true){
+            const uint32_t seen = events_.load(std::memory_order_acquire);
+            if(try_pop(value)){
+                return true;
+            }
+            if(closed_.load(std::memory_order_acquire)){
+                return try_pop(value);
+            }
+            events_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // Returns false when the queue is empty
+    bool try_pop(T& value){
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if(head == tail_.load(std::memory_order_acquire)){
+            return false;
+        }
+        value = std::move(cells_[head % capacity_]);
+        head_.store(head + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    // Wake both sides, from either of them or a third thread
+    void close(){
+        closed_.store(true, std::memory_order_release);
+        signal();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<T[]> cells_;
+
+    alignas(64) std::atomic<size_t> head_{0};   // next to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail_{0};   // next to push, written by the producer
+    alignas(64) std::atomic<uint32_t> events_{0};
+    std::atomic<bool> closed_{false};
+
+    void signal(){
+        events_.fetch_add(1, std::memory_order_acq_rel);
+        events_.notify_all();
+    }
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef SYNCINDEX_HPP
+#define SYNCINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sync points of a single Fano stream.
+// Every `interval` symbols the encoder records where the next code starts in
+// the payload and how many symbols precede it, so decoding can start there
+class SyncIndex{
+public:
+    struct Point{
+        uint64_t bit_offset = 0;    // from the start of the payload
+        uint64_t output_offset = 0; // symbols before the point
+    };
+
+    uint64_t interval = 0;
+    uint64_t total_symbols = 0;
+    uint64_t total_bits = 0;
+    std::vector<Point> points;
+
+    bool empty() const { return points.empty(); }
+
+    // Last point at or before symbol `offset`
+    size_t find(uint64_t offset) const;
+
+    // Throws if points do not start at {0, 0}, are out of order or out of the stream,
+    // source names the index in the log
+    void check(const std::string& source) const;
+
+    // Text file: "interval total_symbols total_bits count", then one point per line
+    void write(const std::string& path) const;
+    void read(const std::string& path);
+
+    // Index file kept next to the alphabet
+    static std::string path_for(const std::string& alphabet_path) { return alphabet_path + ".idx"; }
+};
+
+#endif
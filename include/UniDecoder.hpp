@@ -1,38 +1,117 @@
+#include "Code.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "OutputBuffer.hpp"
+#include "OutputFile.hpp"
+#include "UniformKernels.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <vector>
 #include <fstream>
 #include <string>
+#include <utility>
 
+// Input path "-" reads stdin, output path "-" writes decoded bytes to stdout
 class UniDecoder{
 public:
     UniDecoder(std::string input_path_text, std::string input_path_alphabet,
     std::string output_path = "encoded.txt")
         : input_path_text_(input_path_text),
-        input_path_alphabet_(input_path_alphabet), output_path_(output_path) {}
+        input_path_alphabet_(input_path_alphabet), output_path_(output_path) { OutputFile::reserve_stdout(output_path_); }
 
     void start();
 
+    // Threads for decoding a file, 0 - one per hardware thread.
+    // Every code has the same length, so slices of the payload start at known
+    // bits and go to known output offsets: they are decoded at once and written
+    // in place, files written to stdout are decoded in order on one thread
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // First bytes of stdin, when the caller already read them to tell the engine
+    void set_stdin_head(std::vector<uint8_t> head) { stdin_head_ = std::move(head); }
+
+    // Print the first decoded symbols to stdout when done, on by default
+    void set_preview(bool preview) { preview_ = preview; }
+
+    // Write metrics of every run as JSON to this file, empty - do not write
+    void set_metrics_path(std::string path) { metrics_path_ = std::move(path); }
+
+    // Phase timings and sizes of the last start()
+    const Metrics& metrics() const { return metrics_; }
+
+    // Use fixed length codes of a container code table, empty for symbols not in the alphabet
+    void set_codes(const std::array<Code, 256>& codes);
+
+    // Decode payload of size bytes, the last one with padding unused low bits
+    void bit_decode(const uint8_t* data, size_t size, unsigned padding, OutputBuffer& output);
+
+    // Decode bytes [begin, end) of the original file. Symbol i of a block is
+    // bits [i * length, (i + 1) * length) of its payload, so only the codes of the range are read
+    std::vector<unsigned char> decode_range(uint64_t begin, uint64_t end);
+
 private:
     std::string input_path_text_;
     std::string input_path_alphabet_;
     std::string output_path_;
 
+    // Whole input, container or legacy payload
+    MappedFile input_;
+    std::optional<std::vector<uint8_t>> stdin_head_;
+    unsigned threads_ = 0;
+
+    // Payload of fixed length codes: a container block or the legacy payload
+    struct Segment{
+        const uint8_t* payload = nullptr;
+        uint64_t symbols = 0;
+        uint64_t bit_count = 0;
+        uint64_t output_offset = 0;
+        unsigned length = 0;
+        UniformKernels::Kernels kernels;
+        UniformKernels::ByteMap map;
+    };
+    // Segments of input_, in output order
+    std::vector<Segment> segments_;
+
+    // Smallest slice of parallel decoding and largest piece decoded at once
+    static constexpr uint64_t SLICE_SIZE = uint64_t{1} << 20;
+
+    Metrics metrics_;
+    std::string metrics_path_;
+
     // Number of symbols to cout while decoding
     int cout_number_ = 10;
 
+    bool preview_ = true;
+
     // Lenght of code for each symbol
     unsigned int length_ = 0;
 
-    // Index is code that transformed into unsigned int, unsigned char - symbol
-    std::vector<int> codeToSymb_ {std::vector<int>(256, -1)};
+    // Symbol of every code
+    UniformKernels::ByteMap symbols_;
+
+    // Unpack kernel of length_, bound when the codes are known
+    UniformKernels::Kernels kernels_;
+    void bind_kernels();
 
     // Read alhpabet
     void read_alphabet(std::ifstream& input_file);
 
-    // Decode text
-    void bit_decode(std::ifstream& input_file);
+    // Open input and read segments of a container or of a legacy payload, once
+    void load();
+    void load_container();
+
+    // Segment of size payload bytes, the last one with padding unused low bits, with the current codes
+    Segment make_segment(const uint8_t* data, size_t size, unsigned padding) const;
+
+    // Symbols [from, to) of segment into out
+    static void decode_symbols(const Segment& segment, uint64_t from, uint64_t to, uint8_t* out);
+    static void decode_segment(const Segment& segment, OutputBuffer& output);
+
+    // Decode slices of all segments on a thread pool, each written at its output offset
+    void parallel_decode(uint64_t total);
 
     // Transform code string to unsigned int (MSB-first)
     unsigned int code_string_to_uint(const std::string &s);
-
-    
 };
\ No newline at end of file
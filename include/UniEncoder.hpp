@@ -1,26 +1,60 @@
+#include "BitWriter.hpp"
+#include "Code.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "OutputFile.hpp"
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <string>
 #include <array>
+#include <span>
+#include <utility>
 
+// Input path "-" reads stdin, output path "-" writes the container to stdout
 class UniEncoder{
 public:
     UniEncoder(std::string input_path, std::string output_path_text = "encoded.bin",
     std::string output_path_alphabet = "encoded_alphabet.txt")
         : input_path_(input_path), output_path_text_(output_path_text),
-        output_path_alphabet_(output_path_alphabet) {}
+        output_path_alphabet_(output_path_alphabet) { OutputFile::reserve_stdout(output_path_text_); }
     
     void start();
+
+    // Threads for the counting pass, 0 - one per hardware thread
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // Write a single container file (default), false - legacy payload file with a separate text alphabet
+    void set_container(bool container) { container_ = container; }
+
+    // Print the first codes to stdout while encoding, on by default
+    void set_preview(bool preview) { preview_ = preview; }
+
+    // Write metrics of every run as JSON to this file, empty - do not write
+    void set_metrics_path(std::string path) { metrics_path_ = std::move(path); }
+
+    // Phase timings and sizes of the last start()
+    const Metrics& metrics() const { return metrics_; }
+
+    // Symbols packed at once by the kernels
+    static constexpr size_t CHUNK_SIZE = size_t{1} << 14;
+
+    // Encode data with the fixed length codes into writer.
+    // Codes of one width up to 8 bits on a byte aligned writer go through UniformKernels
+    static void encode_span(std::span<const uint8_t> data, const std::array<Code, 256>& codes, BitWriter& writer);
 private:
     std::string input_path_;
     std::string output_path_text_;
     std::string output_path_alphabet_;
 
-    // Index is unsigned char symbol, string - code
-    std::array<std::string, 256> symbToCode_ {};
+    // Input bytes shared by the counting and the encoding pass
+    MappedFile input_;
 
-    // Index is unsigned char symbol, unsigned int - its number in text
-    std::array<unsigned, 256> chars_ {};
+    // Index is unsigned char symbol, Code - its fixed length code
+    std::array<Code, 256> symbToCode_ {};
+
+    // Index is unsigned char symbol, value - its number in text
+    std::array<uint64_t, 256> chars_ {};
 
     // Lenght of code for each symbol
     unsigned int length_ = 0;
@@ -31,6 +65,16 @@ private:
     // Number of symbols to cout while encoding
     int cout_number = 10;
 
+    // Threads for the counting pass
+    unsigned threads_ = 0;
+
+    bool container_ = true;
+
+    bool preview_ = true;
+
+    Metrics metrics_;
+    std::string metrics_path_;
+
     // Fill symbToCode
     void make_alphabet();
 
@@ -39,11 +83,17 @@ private:
 
     // Encode sigle symbol
     // index is symbol's sequence number
-    void encode_sigle_symbol(unsigned index, std::string& buf);
+    void encode_sigle_symbol(unsigned index, Code& code);
 
     // Write the alphabet
     void write_alphabet(std::ofstream& output_file);
 
     // Encode text to binary (bit) format file
     void bit_encode();
+
+    // Encode text into a single block container
+    void container_encode();
+
+    // Encode all input symbols into writer, printing the first codes when preview is set
+    void encode_payload(BitWriter& writer, bool preview);
 };
\ No newline at end of file
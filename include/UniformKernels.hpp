@@ -0,0 +1,63 @@
+#ifndef UNIFORMKERNELS_HPP
+#define UNIFORMKERNELS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Pack and unpack kernels for the fixed width codes of the Uniform engine.
+// Codes of 1 to 8 bits go back to back, MSB-first, so every 8 codes take
+// exactly `width` bytes and the kernels move whole groups of 8 at a time.
+// The implementation is picked once by CPU features: AVX2 (32 codes per
+// step), BMI2 pdep/pext (8 codes per step) or a portable 64-bit scalar loop.
+// Each one is compiled for every width, callers take the pair for their
+// width from a table once the width is known. All of them produce the same bytes
+class UniformKernels{
+public:
+    enum class Isa{
+        Scalar,
+        Bmi2,
+        Avx2
+    };
+
+    static constexpr unsigned MAX_WIDTH = 8;
+
+    // Kernels of one width
+    struct Kernels{
+        unsigned width = 0;
+
+        // Pack count codes, each in the low bits of a byte, into (count * width + 7) / 8 bytes
+        void (*pack)(const uint8_t* codes, size_t count, uint8_t* out) = nullptr;
+
+        // Unpack count codes from (count * width + 7) / 8 bytes, one code per byte
+        void (*unpack)(const uint8_t* data, size_t count, uint8_t* codes) = nullptr;
+    };
+
+    // Byte to byte lookup: symbols to codes when encoding, codes to symbols when decoding
+    struct ByteMap{
+        std::array<uint8_t, 256> value{};
+        std::array<bool, 256> valid{};
+    };
+
+    // Best implementation this CPU supports
+    static Isa best();
+    static bool supported(Isa isa);
+
+    // Implementation in use, best() unless changed by set_isa()
+    static Isa isa();
+
+    // Force an implementation, for benchmarks and comparisons. Throws if the CPU does not support it.
+    // Kernels taken by for_width() before keep their implementation
+    static void set_isa(Isa isa);
+
+    static const char* name(Isa isa);
+
+    // Kernels of the current implementation for codes of 1..MAX_WIDTH bits, throws for other widths
+    static Kernels for_width(unsigned width);
+
+    // out[i] = map.value[in[i]], in and out may be the same.
+    // Returns index of the first byte with no valid value, count if there is none
+    static size_t map(const uint8_t* in, size_t count, const ByteMap& map, uint8_t* out);
+};
+
+#endif
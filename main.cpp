@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <cctype>
+#include "Cli.hpp"
 #include "Decoder.hpp"
 #include "Encoder.hpp"
 #include "UniDecoder.hpp"
@@ -12,7 +13,11 @@ std::string getProjectRoot() {
     return std::filesystem::current_path().parent_path().string();
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if(argc > 1){
+        return Cli::run(argc, argv);
+    }
+
     std::string projectRoot = getProjectRoot();
     Logger& logger = Logger::getInstance();
     logger.setLogFile("application.log");
@@ -34,8 +39,8 @@ int main() {
         std::cout << "Enter path to output file:\n";
         std::cin >> output;
 
-        std::string fullInputPath = projectRoot + "\\" + input;
-        std::string fullOutputPath = projectRoot + "\\" + output;
+        std::string fullInputPath = (std::filesystem::path(projectRoot) / input).string();
+        std::string fullOutputPath = (std::filesystem::path(projectRoot) / output).string();
 
         mode = std::toupper(mode);
 
@@ -48,7 +53,7 @@ int main() {
                     std::string input_alphabet, fullAlphabetPath;
                     std::cout << "Enter path to input alphabet file:\n";
                     std::cin >> input_alphabet;
-                    fullAlphabetPath = projectRoot + "\\" + input_alphabet;
+                    fullAlphabetPath = (std::filesystem::path(projectRoot) / input_alphabet).string();
                     if(code_mode == 'U' || code_mode == 'u'){
                         UniDecoder decoder(fullInputPath, fullAlphabetPath, fullOutputPath);
                         decoder.start();
@@ -72,7 +77,7 @@ int main() {
                     std::string output_alphabet, fullAlphabetPath;
                     std::cout << "Enter path to output alphabet file:\n";
                     std::cin >> output_alphabet;
-                    fullAlphabetPath = projectRoot + "\\" + output_alphabet;
+                    fullAlphabetPath = (std::filesystem::path(projectRoot) / output_alphabet).string();
                     UniEncoder encoder(fullInputPath, fullOutputPath, fullAlphabetPath);
                     encoder.start();
                     if(code_mode == 'U' || code_mode == 'u'){
@@ -0,0 +1,72 @@
+#include "BitWriter.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#define LOG Logger::getInstance()
+
+BitWriter::BitWriter(std::ostream& output, size_t buffer_size)
+    : stream_(&output), buffer_(std::max<size_t>(buffer_size, sizeof(uint64_t)) / sizeof(uint64_t) * sizeof(uint64_t)) {}
+
+BitWriter::BitWriter(std::vector<uint8_t>& output, size_t buffer_size)
+    : memory_(&output), buffer_(std::max<size_t>(buffer_size, sizeof(uint64_t)) / sizeof(uint64_t) * sizeof(uint64_t)) {}
+
+void BitWriter::flush_buffer(){
+    if(memory_){
+        memory_->insert(memory_->end(), buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(pos_));
+        pos_ = 0;
+        return;
+    }
+
+    stream_->write(buffer_.data(), static_cast<std::streamsize>(pos_));
+    if(!*stream_){
+        LOG.error("Error in writing encoded data", "BitWriter::flush_buffer");
+        throw std::runtime_error("Error in writing file");
+    }
+    pos_ = 0;
+}
+
+void BitWriter::put_bytes(const uint8_t* data, size_t size){
+    const unsigned used = 64 - free_;
+    if(used % 8 != 0){
+        LOG.error("Bytes put at bit " + std::to_string(bit_count()), "BitWriter::put_bytes");
+        throw std::logic_error("BitWriter is not byte aligned");
+    }
+    if(pos_ + used / 8 > buffer_.size()){
+        flush_buffer();
+    }
+    for(unsigned i = 0; i < used / 8; ++i){
+        buffer_[pos_++] = static_cast<char>(acc_ >> (56 - 8 * i));
+    }
+    bytes_ += used / 8;
+    acc_ = 0;
+    free_ = 64;
+
+    while(size != 0){
+        if(pos_ == buffer_.size()){
+            flush_buffer();
+        }
+        const size_t n = std::min(size, buffer_.size() - pos_);
+        std::memcpy(buffer_.data() + pos_, data, n);
+        pos_ += n;
+        data += n;
+        size -= n;
+        bytes_ += n;
+    }
+}
+
+uint8_t BitWriter::finish(){
+    const unsigned used = 64 - free_;
+    const unsigned bytes = (used + 7) / 8;
+    if(pos_ + bytes > buffer_.size()){
+        flush_buffer();
+    }
+    for(unsigned i = 0; i < bytes; ++i){
+        buffer_[pos_++] = static_cast<char>(acc_ >> (56 - 8 * i));
+    }
+    flush_buffer();
+
+    return static_cast<uint8_t>(bytes * 8 - used);
+}
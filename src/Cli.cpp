@@ -0,0 +1,445 @@
+#include "Cli.hpp"
+#include "Container.hpp"
+#include "ContainerStream.hpp"
+#include "Decoder.hpp"
+#include "Encoder.hpp"
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+#include "OutputFile.hpp"
+#include "ThreadPool.hpp"
+#include "UniDecoder.hpp"
+#include "UniEncoder.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+
+#define LOG Logger::getInstance()
+
+namespace fs = std::filesystem;
+
+namespace{
+
+constexpr const char* SUFFIX = ".fano";
+
+unsigned long long parse_number(const std::string& option, const std::string& value){
+    size_t used = 0;
+    unsigned long long number = 0;
+    try{
+        number = std::stoull(value, &used);
+    }
+    catch(const std::exception&){
+        used = 0;
+    }
+    if(used == 0 || used != value.size() || value[0] == '-'){
+        throw std::invalid_argument("invalid number for " + option + ": " + value);
+    }
+    return number;
+}
+
+Logger::Level parse_level(const std::string& value){
+    if(value == "debug") return Logger::Level::DEBUG;
+    if(value == "info") return Logger::Level::INFO;
+    if(value == "warning") return Logger::Level::WARNING;
+    if(value == "error") return Logger::Level::ERROR;
+    throw std::invalid_argument("unknown log level " + value);
+}
+
+Pipeline::Io parse_io(const std::string& value){
+    if(value == "auto") return Pipeline::Io::Auto;
+    if(value == "threads") return Pipeline::Io::Threads;
+    if(value == "uring") return Pipeline::Io::IoUring;
+    throw std::invalid_argument("unknown pipeline I/O " + value);
+}
+
+std::string trim(const std::string& s){
+    const size_t begin = s.find_first_not_of(" \t\r");
+    if(begin == std::string::npos) return "";
+    const size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+}
+
+void Cli::print_usage(std::ostream& out){
+    out << "usage: Fano (-e | -d) [options] [INPUT...]\n"
+           "       Fano            interactive mode\n"
+           "\n"
+           "  -e, --encode             encode inputs into containers\n"
+           "  -d, --decode             decode containers\n"
+           "      --engine NAME        fano or uniform; decoding reads it from the container\n"
+           "  -o, --output PATH        output of a single input, - for stdout\n"
+           "      --output-dir DIR     write outputs into DIR, named after the inputs\n"
+           "  -m, --manifest FILE      more jobs, one per line: INPUT or INPUT<TAB>OUTPUT, - for stdin\n"
+           "  -b, --block-size BYTES   encode in independent blocks (fano)\n"
+           "  -s, --sync-interval N    sync point every N symbols (fano)\n"
+           "  -L, --max-code-length N  no code longer than N bits, 0 - not limited (fano)\n"
+           "      --streams N          interleaved bitstreams per block: 1, 2, 4 or 8 (fano)\n"
+           "      --pipeline IO        read, code and write blocks on separate stages, IO: auto,\n"
+           "                           uring or threads (fano, blocked, file to file)\n"
+           "  -t, --threads N          threads per file, 0 - all for one file, 1 for many\n"
+           "  -j, --jobs N             files processed at once, 0 - one per hardware thread\n"
+           "      --metrics FILE       write a JSON line of metrics per finished file\n"
+           "      --log-level LEVEL    debug, info, warning (default) or error\n"
+           "  -q, --quiet              report failed files only\n"
+           "  -h, --help               show this help\n"
+           "\n"
+           "Input - reads stdin. Without an output, encoding writes INPUT.fano and\n"
+           "decoding strips .fano (or appends .out). Exit status: 0 - every file done,\n"
+           "1 - some files failed, 2 - invalid arguments.\n";
+}
+
+Cli::Options Cli::parse(int argc, char** argv){
+    Options options;
+    bool inputs_only = false;
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if(i + 1 >= argc){
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if(inputs_only || arg == "-" || arg.empty() || arg[0] != '-'){
+            options.inputs.push_back(arg);
+        }
+        else if(arg == "--") inputs_only = true;
+        else if(arg == "-e" || arg == "--encode" || arg == "-d" || arg == "--decode"){
+            const Mode mode = (arg == "-e" || arg == "--encode") ? Mode::Encode : Mode::Decode;
+            if(options.mode != Mode::None && options.mode != mode){
+                throw std::invalid_argument("--encode and --decode are exclusive");
+            }
+            options.mode = mode;
+        }
+        else if(arg == "--engine"){
+            const std::string name = value();
+            if(name == "fano") options.engine = Engine::Fano;
+            else if(name == "uniform") options.engine = Engine::Uniform;
+            else throw std::invalid_argument("unknown engine " + name);
+        }
+        else if(arg == "-o" || arg == "--output") options.output = value();
+        else if(arg == "--output-dir") options.output_dir = value();
+        else if(arg == "-m" || arg == "--manifest") options.manifest = value();
+        else if(arg == "-b" || arg == "--block-size") options.block_size = parse_number(arg, value());
+        else if(arg == "-s" || arg == "--sync-interval") options.sync_interval = parse_number(arg, value());
+        else if(arg == "-L" || arg == "--max-code-length"){
+            options.max_code_length = static_cast<unsigned>(parse_number(arg, value()));
+            if(options.max_code_length > FanoTable::MAX_LENGTH_LIMIT){
+                throw std::invalid_argument(arg + " must be at most " + std::to_string(FanoTable::MAX_LENGTH_LIMIT));
+            }
+        }
+        else if(arg == "--streams"){
+            options.streams = static_cast<unsigned>(parse_number(arg, value()));
+            if(options.streams != 1 && !Container::valid_lanes(options.streams)){
+                throw std::invalid_argument(arg + " must be 1, 2, 4 or 8");
+            }
+        }
+        else if(arg == "--pipeline"){
+            options.pipeline = true;
+            options.pipeline_io = parse_io(value());
+        }
+        else if(arg == "-t" || arg == "--threads") options.threads = static_cast<unsigned>(parse_number(arg, value()));
+        else if(arg == "-j" || arg == "--jobs") options.jobs = static_cast<unsigned>(parse_number(arg, value()));
+        else if(arg == "--metrics") options.metrics_path = value();
+        else if(arg == "--log-level") LOG.setLogLevel(parse_level(value()));
+        else if(arg == "-q" || arg == "--quiet") options.quiet = true;
+        else if(arg == "-h" || arg == "--help"){
+            print_usage(std::cout);
+            std::exit(OK);
+        }
+        else throw std::invalid_argument("unknown option " + arg);
+    }
+
+    if(options.mode == Mode::None){
+        throw std::invalid_argument("one of --encode or --decode is required");
+    }
+    if(options.inputs.empty() && options.manifest.empty()){
+        throw std::invalid_argument("no input files");
+    }
+    if(options.engine == Engine::Uniform &&
+       (options.block_size != 0 || options.sync_interval != 0 || options.max_code_length != 0 || options.streams != 1)){
+        throw std::invalid_argument("--block-size, --sync-interval, --max-code-length and --streams need the fano engine");
+    }
+    if(options.streams != 1 && options.sync_interval != 0){
+        throw std::invalid_argument("--streams can not be combined with --sync-interval");
+    }
+    return options;
+}
+
+std::string Cli::default_output(const std::string& input, Mode mode, const std::string& output_dir){
+    if(input == MappedFile::STDIN_PATH){
+        return OutputFile::STDOUT_PATH;
+    }
+    fs::path output(input);
+    if(mode == Mode::Encode){
+        output += SUFFIX;
+    }
+    else if(output.extension() == SUFFIX){
+        output.replace_extension();
+    }
+    else{
+        output += ".out";
+    }
+    if(!output_dir.empty()){
+        output = fs::path(output_dir) / output.filename();
+    }
+    return output.string();
+}
+
+std::vector<Cli::Job> Cli::read_manifest(const std::string& path){
+    std::ifstream file;
+    std::istream* input = &std::cin;
+    if(path != MappedFile::STDIN_PATH){
+        file.open(path);
+        if(!file.is_open()){
+            throw std::invalid_argument("cannot open manifest " + path);
+        }
+        input = &file;
+    }
+
+    std::vector<Job> jobs;
+    std::string line;
+    while(std::getline(*input, line)){
+        line = trim(line);
+        if(line.empty() || line[0] == '#') continue;
+        const size_t tab = line.find('\t');
+        if(tab == std::string::npos){
+            jobs.push_back({line, ""});
+        }
+        else{
+            jobs.push_back({trim(line.substr(0, tab)), trim(line.substr(tab + 1))});
+        }
+    }
+    return jobs;
+}
+
+std::vector<Cli::Job> Cli::make_jobs(const Options& options){
+    std::vector<Job> jobs;
+    for(const auto& input : options.inputs){
+        jobs.push_back({input, ""});
+    }
+    if(!options.manifest.empty()){
+        for(auto& job : read_manifest(options.manifest)){
+            jobs.push_back(std::move(job));
+        }
+    }
+    if(jobs.empty()){
+        throw std::invalid_argument("no input files");
+    }
+
+    if(!options.output.empty()){
+        if(jobs.size() != 1){
+            throw std::invalid_argument("--output needs a single input, use --output-dir");
+        }
+        if(jobs[0].output.empty()){
+            jobs[0].output = options.output;
+        }
+    }
+    for(auto& job : jobs){
+        if(job.output.empty()){
+            job.output = default_output(job.input, options.mode, options.output_dir);
+        }
+    }
+
+    // Standard streams and outputs can be used by one job only
+    const auto stdin_jobs = std::count_if(jobs.begin(), jobs.end(), [](const Job& job){
+        return job.input == MappedFile::STDIN_PATH;
+    });
+    const auto stdout_jobs = std::count_if(jobs.begin(), jobs.end(), [](const Job& job){
+        return OutputFile::is_stdout_path(job.output);
+    });
+    if(stdin_jobs > 1 || (stdin_jobs == 1 && options.manifest == MappedFile::STDIN_PATH)){
+        throw std::invalid_argument("stdin can be read by one job only");
+    }
+    if(stdout_jobs > 0 && jobs.size() > 1){
+        throw std::invalid_argument("stdout can be written by a single job only");
+    }
+    std::vector<std::string> outputs;
+    for(const auto& job : jobs){
+        outputs.push_back(fs::path(job.output).lexically_normal().string());
+    }
+    std::sort(outputs.begin(), outputs.end());
+    const auto duplicate = std::adjacent_find(outputs.begin(), outputs.end());
+    if(duplicate != outputs.end()){
+        throw std::invalid_argument("several jobs write " + *duplicate);
+    }
+
+    // Writing an input truncates it while it is being read
+    for(const auto& job : jobs){
+        std::error_code error;
+        if(OutputFile::is_stdout_path(job.output) || !fs::exists(job.output, error)){
+            continue;
+        }
+        for(const auto& other : jobs){
+            if(other.input != MappedFile::STDIN_PATH && fs::equivalent(job.output, other.input, error)){
+                throw std::invalid_argument("job writes " + job.output + ", which is the input " + other.input);
+            }
+        }
+    }
+    return jobs;
+}
+
+Cli::Engine Cli::detect_engine(const std::string& path, std::vector<uint8_t>& head){
+    if(path == MappedFile::STDIN_PATH){
+        head = ContainerStream::read_head(std::cin);
+        if(!Container::is_container(head.data(), head.size())){
+            return Engine::Fano;
+        }
+        return Container::read_header(head.data(), head.size()).engine == Container::Engine::Uniform ? Engine::Uniform : Engine::Fano;
+    }
+    std::ifstream file(path, std::ios::binary);
+    uint8_t header[Container::HEADER_SIZE] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    const auto size = static_cast<size_t>(file.gcount());
+    if(!file.is_open()){
+        throw std::runtime_error("Error in opening file");
+    }
+    if(!Container::is_container(header, size)){
+        throw std::runtime_error("Not a container, legacy files are decoded in the interactive mode");
+    }
+    return Container::read_header(header, size).engine == Container::Engine::Uniform ? Engine::Uniform : Engine::Fano;
+}
+
+Cli::Result Cli::run_job(const Job& job, const Options& options, unsigned threads){
+    Result result;
+    try{
+        Engine engine = options.engine;
+        if(options.mode == Mode::Encode){
+            if(engine == Engine::Uniform){
+                UniEncoder encoder(job.input, job.output);
+                encoder.set_threads(threads);
+                encoder.set_preview(false);
+                encoder.start();
+                result.metrics = encoder.metrics();
+            }
+            else{
+                Encoder encoder(job.input, job.output);
+                encoder.set_threads(threads);
+                encoder.set_block_size(options.block_size);
+                encoder.set_sync_interval(options.sync_interval);
+                encoder.set_max_code_length(options.max_code_length);
+                encoder.set_streams(options.streams);
+                encoder.set_pipeline(options.pipeline);
+                encoder.set_pipeline_io(options.pipeline_io);
+                encoder.set_preview(false);
+                encoder.start();
+                result.metrics = encoder.metrics();
+            }
+        }
+        else{
+            std::vector<uint8_t> head;
+            const bool detected = engine == Engine::Auto;
+            if(detected){
+                engine = detect_engine(job.input, head);
+            }
+            const bool head_read = detected && job.input == MappedFile::STDIN_PATH;
+            if(engine == Engine::Uniform){
+                UniDecoder decoder(job.input, "", job.output);
+                if(head_read){
+                    decoder.set_stdin_head(std::move(head));
+                }
+                decoder.set_threads(threads);
+                decoder.set_preview(false);
+                decoder.start();
+                result.metrics = decoder.metrics();
+            }
+            else{
+                Decoder decoder(job.input, "", job.output);
+                if(head_read){
+                    decoder.set_stdin_head(std::move(head));
+                }
+                decoder.set_threads(threads);
+                decoder.set_pipeline(options.pipeline);
+                decoder.set_pipeline_io(options.pipeline_io);
+                decoder.set_preview(false);
+                decoder.start();
+                result.metrics = decoder.metrics();
+            }
+        }
+        result.metrics.input = job.input;
+        result.ok = true;
+    }
+    catch(const std::exception& e){
+        result.error = e.what();
+    }
+    return result;
+}
+
+int Cli::run(int argc, char** argv){
+    // Logs never mix with data written to stdout
+    LOG.setLogToStderr(true);
+    LOG.setLogLevel(Logger::Level::WARNING);
+
+    Options options;
+    std::vector<Job> jobs;
+    try{
+        options = parse(argc, argv);
+        jobs = make_jobs(options);
+    }
+    catch(const std::invalid_argument& e){
+        std::cerr << "Fano: " << e.what() << "\n\n";
+        print_usage(std::cerr);
+        return USAGE;
+    }
+
+    if(!options.output_dir.empty()){
+        std::error_code error;
+        fs::create_directories(options.output_dir, error);
+        if(error){
+            std::cerr << "Fano: cannot create " << options.output_dir << ": " << error.message() << '\n';
+            return FAILED;
+        }
+    }
+
+    const auto workers = static_cast<unsigned>(
+        std::min<size_t>(options.jobs != 0 ? options.jobs : ThreadPool::hardware_threads(), jobs.size()));
+    const unsigned threads = options.threads != 0 ? options.threads : (workers > 1 ? 1 : 0);
+    LOG_INFO("Running {} jobs on {} workers, {} threads each", "Cli::run", jobs.size(), workers, threads);
+
+    std::vector<std::future<Result>> results;
+    {
+        ThreadPool pool(workers);
+        for(const auto& job : jobs){
+            results.push_back(pool.submit([&job, &options, threads]() { return run_job(job, options, threads); }));
+        }
+
+        // Reported in job order, as soon as each one and all before it are done
+        std::ofstream metrics;
+        if(!options.metrics_path.empty()){
+            metrics.open(options.metrics_path);
+            if(!metrics.is_open()){
+                std::cerr << "Fano: cannot open " << options.metrics_path << '\n';
+            }
+        }
+
+        size_t failed = 0;
+        for(size_t i = 0; i < jobs.size(); ++i){
+            const Result result = results[i].get();
+            if(!result.ok){
+                ++failed;
+                std::cerr << "FAILED " << jobs[i].input << ": " << result.error << '\n';
+                continue;
+            }
+            if(!options.quiet){
+                std::cerr << "ok " << jobs[i].input << " -> " << jobs[i].output << " ("
+                          << result.metrics.bytes_in << " -> " << result.metrics.bytes_out << " bytes, "
+                          << result.metrics.total_seconds << " s)\n";
+            }
+            if(metrics.is_open()){
+                metrics << result.metrics.to_json() << '\n';
+            }
+        }
+
+        if(!options.quiet || failed != 0){
+            std::cerr << jobs.size() - failed << " of " << jobs.size() << " files done\n";
+        }
+        if(failed != 0 || (!options.metrics_path.empty() && !metrics)){
+            return FAILED;
+        }
+    }
+    return OK;
+}
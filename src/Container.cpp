@@ -0,0 +1,284 @@
+#include "Container.hpp"
+#include "BitReader.hpp"
+#include "Logger.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#define LOG Logger::getInstance()
+
+void Container::put_u16(std::vector<uint8_t>& out, uint16_t value){
+    for(size_t i = 0; i < sizeof(value); ++i){
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Container::put_u32(std::vector<uint8_t>& out, uint32_t value){
+    for(size_t i = 0; i < sizeof(value); ++i){
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Container::put_u64(std::vector<uint8_t>& out, uint64_t value){
+    for(size_t i = 0; i < sizeof(value); ++i){
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+uint64_t Container::get_le(const uint8_t* data, size_t bytes){
+    uint64_t value = 0;
+    for(size_t i = 0; i < bytes; ++i){
+        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool Container::is_container(const uint8_t* data, size_t size){
+    return size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void Container::write_header(std::vector<uint8_t>& out, const Header& header){
+    out.insert(out.end(), std::begin(MAGIC), std::end(MAGIC));
+    out.push_back(header.version);
+    out.push_back(static_cast<uint8_t>(header.engine));
+    out.push_back(header.flags);
+    out.push_back(header.max_code_length);
+    put_u64(out, header.original_size);
+    put_u64(out, header.block_size);
+    put_u32(out, header.block_count);
+    out.push_back(header.flags & INTERLEAVED ? header.lanes : 0);
+    out.push_back(0);
+    out.push_back(0);
+    out.push_back(0);
+}
+
+Container::Header Container::read_header(const uint8_t* data, size_t size){
+    if(size < HEADER_SIZE || !is_container(data, size)){
+        LOG.error("Input is not a Fano container", "Container::read_header");
+        throw std::runtime_error("Input is not a Fano container");
+    }
+
+    Header header;
+    header.version = data[4];
+    header.engine = static_cast<Engine>(data[5]);
+    header.flags = data[6];
+    header.max_code_length = data[7];
+    header.original_size = get_le(data + 8, 8);
+    header.block_size = get_le(data + 16, 8);
+    header.block_count = static_cast<uint32_t>(get_le(data + 24, 4));
+    header.lanes = header.flags & INTERLEAVED ? data[28] : 1;
+
+    if(header.version != VERSION){
+        LOG.error("Unsupported container version " + std::to_string(header.version), "Container::read_header");
+        throw std::runtime_error("Unsupported container version");
+    }
+    if(header.engine != Engine::Fano && header.engine != Engine::Uniform){
+        LOG.error("Unknown engine id " + std::to_string(data[5]), "Container::read_header");
+        throw std::runtime_error("Unknown engine id");
+    }
+    if(header.flags & INTERLEAVED){
+        if(!valid_lanes(header.lanes) || header.engine != Engine::Fano || header.flags & SYNC_INDEX){
+            LOG.error("Invalid interleaving with " + std::to_string(header.lanes) + " lanes", "Container::read_header");
+            throw std::runtime_error("Corrupted file: invalid interleaving");
+        }
+    }
+    return header;
+}
+
+void Container::write_directory(std::vector<uint8_t>& out, const std::vector<BlockEntry>& entries){
+    for(const auto& entry : entries){
+        put_u64(out, entry.offset);
+        put_u64(out, entry.raw_size);
+        put_u64(out, entry.bit_count);
+    }
+}
+
+std::vector<Container::BlockEntry> Container::read_directory(const uint8_t* data, size_t size, const Header& header){
+    const uint64_t directory_end = HEADER_SIZE + static_cast<uint64_t>(header.block_count) * ENTRY_SIZE;
+    if(directory_end > size){
+        LOG.error("Block directory is truncated", "Container::read_directory");
+        throw std::runtime_error("Corrupted file: block directory is truncated");
+    }
+
+    std::vector<BlockEntry> entries(header.block_count);
+    uint64_t total = 0;
+    for(size_t i = 0; i < entries.size(); ++i){
+        const uint8_t* p = data + HEADER_SIZE + i * ENTRY_SIZE;
+        entries[i].offset = get_le(p, 8);
+        entries[i].raw_size = get_le(p + 8, 8);
+        entries[i].bit_count = get_le(p + 16, 8);
+
+        const uint64_t payload_bytes = (entries[i].bit_count + 7) / 8;
+        if(entries[i].offset < directory_end || entries[i].offset > size ||
+           payload_bytes > size - entries[i].offset){
+            LOG.error("Block " + std::to_string(i) + " is out of file bounds", "Container::read_directory");
+            throw std::runtime_error("Corrupted file: block is out of file bounds");
+        }
+        total += entries[i].raw_size;
+    }
+
+    if(total != header.original_size){
+        LOG.error("Block sizes do not add up to the original size", "Container::read_directory");
+        throw std::runtime_error("Corrupted file: block sizes mismatch");
+    }
+    return entries;
+}
+
+void Container::write_codes(std::vector<uint8_t>& out, const std::array<Code, 256>& codes){
+    uint16_t count = 0;
+    for(const auto& code : codes){
+        count += code.empty() ? 0 : 1;
+    }
+    put_u16(out, count);
+
+    for(size_t i = 0; i < codes.size(); ++i){
+        if(!codes[i].empty()){
+            out.push_back(static_cast<uint8_t>(i));
+            out.push_back(codes[i].length);
+        }
+    }
+
+    uint64_t acc = 0;
+    unsigned filled = 0;
+    for(const auto& code : codes){
+        for(unsigned bit = code.length; bit-- > 0;){
+            acc = (acc << 1) | ((code.bits >> bit) & 1u);
+            if(++filled == 8){
+                out.push_back(static_cast<uint8_t>(acc));
+                acc = 0;
+                filled = 0;
+            }
+        }
+    }
+    if(filled != 0){
+        out.push_back(static_cast<uint8_t>(acc << (8 - filled)));
+    }
+}
+
+size_t Container::read_codes(const uint8_t* data, size_t size, std::array<Code, 256>& codes, unsigned max_length){
+    codes = {};
+    if(max_length == 0 || max_length > Code::MAX_LENGTH){
+        max_length = Code::MAX_LENGTH;
+    }
+    if(size < 2){
+        LOG.error("Code table is truncated", "Container::read_codes");
+        throw std::runtime_error("Corrupted file: code table is truncated");
+    }
+
+    const auto count = static_cast<size_t>(get_le(data, 2));
+    if(count == 0 || count > codes.size() || size < 2 + 2 * count){
+        LOG.error("Invalid code table with " + std::to_string(count) + " symbols", "Container::read_codes");
+        throw std::runtime_error("Corrupted file: invalid code table");
+    }
+
+    // Code lengths, in symbol order, as the bits are stored
+    uint64_t total_bits = 0;
+    for(size_t i = 0; i < count; ++i){
+        const uint8_t symbol = data[2 + 2 * i];
+        const uint8_t length = data[3 + 2 * i];
+        if(length == 0 || length > max_length || !codes[symbol].empty()){
+            LOG.error("Invalid code for symbol " + std::to_string(symbol), "Container::read_codes");
+            throw std::runtime_error("Corrupted file: invalid code table");
+        }
+        codes[symbol].length = length;
+        total_bits += length;
+    }
+
+    const size_t bits_offset = 2 + 2 * count;
+    const size_t bits_bytes = static_cast<size_t>((total_bits + 7) / 8);
+    if(size - bits_offset < bits_bytes){
+        LOG.error("Code table is truncated", "Container::read_codes");
+        throw std::runtime_error("Corrupted file: code table is truncated");
+    }
+
+    BitReader reader(data + bits_offset, bits_bytes, total_bits);
+    for(auto& code : codes){
+        for(unsigned bit = 0; bit < code.length; ++bit){
+            code.bits = (code.bits << 1) | reader.peek(1);
+            reader.skip(1);
+        }
+    }
+    return bits_offset + bits_bytes;
+}
+
+uint64_t Container::interleaved_size(const std::vector<uint64_t>& lane_bits){
+    uint64_t size = 8 * lane_bits.size();
+    for(uint64_t bits : lane_bits){
+        size += (bits + 7) / 8;
+    }
+    return size;
+}
+
+void Container::write_lane_lengths(std::vector<uint8_t>& out, const std::vector<uint64_t>& lane_bits){
+    for(uint64_t bits : lane_bits){
+        put_u64(out, bits);
+    }
+}
+
+std::vector<Container::Lane> Container::read_lanes(const uint8_t* data, size_t size, const BlockEntry& entry, unsigned lanes){
+    if(size < 8 * uint64_t{lanes}){
+        LOG.error("Lane lengths are truncated", "Container::read_lanes");
+        throw std::runtime_error("Corrupted file: lane lengths are truncated");
+    }
+
+    std::vector<Lane> out(lanes);
+    uint64_t offset = 8 * uint64_t{lanes};
+    uint64_t total = 0;
+    for(unsigned i = 0; i < lanes; ++i){
+        out[i].offset = offset;
+        out[i].bit_count = get_le(data + 8 * i, 8);
+        const uint64_t bytes = (out[i].bit_count + 7) / 8;
+        if(out[i].bit_count > entry.bit_count || bytes > size - offset){
+            LOG.error("Lane " + std::to_string(i) + " is out of file bounds", "Container::read_lanes");
+            throw std::runtime_error("Corrupted file: lane is out of file bounds");
+        }
+        offset += bytes;
+        total += out[i].bit_count;
+    }
+    if(total != entry.bit_count){
+        LOG.error("Lane lengths do not add up to the block length", "Container::read_lanes");
+        throw std::runtime_error("Corrupted file: lane lengths mismatch");
+    }
+    return out;
+}
+
+uint64_t Container::lanes_size(const std::vector<Lane>& lanes){
+    return lanes.empty() ? 0 : lanes.back().offset + (lanes.back().bit_count + 7) / 8;
+}
+
+uint64_t Container::index_size(uint64_t raw_size, uint64_t interval){
+    const uint64_t points = interval == 0 ? 0 : (raw_size + interval - 1) / interval;
+    return 16 + 16 * points;
+}
+
+void Container::write_index(std::vector<uint8_t>& out, const SyncIndex& index){
+    put_u64(out, index.interval);
+    put_u64(out, index.points.size());
+    for(const auto& point : index.points){
+        put_u64(out, point.bit_offset);
+        put_u64(out, point.output_offset);
+    }
+}
+
+size_t Container::read_index(const uint8_t* data, size_t size, const BlockEntry& entry, SyncIndex& index){
+    if(size < 16){
+        LOG.error("Sync index is truncated", "Container::read_index");
+        throw std::runtime_error("Corrupted file: sync index is truncated");
+    }
+    index.interval = get_le(data, 8);
+    const uint64_t count = get_le(data + 8, 8);
+    if(count > (size - 16) / 16){
+        LOG.error("Sync index is truncated", "Container::read_index");
+        throw std::runtime_error("Corrupted file: sync index is truncated");
+    }
+
+    index.total_symbols = entry.raw_size;
+    index.total_bits = entry.bit_count;
+    index.points.resize(static_cast<size_t>(count));
+    for(size_t i = 0; i < index.points.size(); ++i){
+        index.points[i].bit_offset = get_le(data + 16 + 16 * i, 8);
+        index.points[i].output_offset = get_le(data + 24 + 16 * i, 8);
+    }
+    index.check("container");
+    return static_cast<size_t>(16 + 16 * count);
+}
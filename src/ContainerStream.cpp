@@ -0,0 +1,180 @@
+#include "ContainerStream.hpp"
+#include "BitReader.hpp"
+#include "DecodeTable.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#define LOG Logger::getInstance()
+
+ContainerStream::ContainerStream(std::istream& input, std::vector<uint8_t> head, std::string name)
+    : input_(input), name_(std::move(name)), buffer_(std::move(head)){
+    fill(Container::HEADER_SIZE);
+    header_ = Container::read_header(data(), available());
+
+    const uint64_t directory_end = Container::HEADER_SIZE + uint64_t{header_.block_count} * Container::ENTRY_SIZE;
+    if(!fill(static_cast<size_t>(directory_end))){
+        LOG.error("Block directory of " + name_ + " is truncated", "ContainerStream::ContainerStream");
+        throw std::runtime_error("Corrupted file: block directory is truncated");
+    }
+    // The size of a stream is unknown, block bounds are checked as the blocks are read
+    entries_ = Container::read_directory(data(), std::numeric_limits<size_t>::max(), header_);
+    pos_ = static_cast<size_t>(directory_end);
+}
+
+std::vector<uint8_t> ContainerStream::read_head(std::istream& input){
+    std::vector<uint8_t> head(Container::HEADER_SIZE);
+    input.read(reinterpret_cast<char*>(head.data()), static_cast<std::streamsize>(head.size()));
+    head.resize(static_cast<size_t>(input.gcount()));
+    return head;
+}
+
+bool ContainerStream::fill(size_t n){
+    if(available() >= n){
+        return true;
+    }
+    if(pos_ != 0){
+        buffer_.erase(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(pos_));
+        offset_ += pos_;
+        pos_ = 0;
+    }
+    // Grown chunk by chunk, a corrupted size can not allocate more than the input holds
+    while(buffer_.size() < n && input_){
+        const size_t size = buffer_.size();
+        buffer_.resize(size + CHUNK_SIZE);
+        input_.read(reinterpret_cast<char*>(buffer_.data() + size), static_cast<std::streamsize>(CHUNK_SIZE));
+        buffer_.resize(size + static_cast<size_t>(input_.gcount()));
+    }
+    if(input_.bad()){
+        LOG.error("Error in reading file " + name_, "ContainerStream::fill");
+        throw std::runtime_error("Error in reading file");
+    }
+    return buffer_.size() >= n;
+}
+
+void ContainerStream::skip_to(uint64_t offset){
+    if(offset < position()){
+        LOG.error("Block at " + std::to_string(offset) + " overlaps the previous one", "ContainerStream::skip_to");
+        throw std::runtime_error("Corrupted file: blocks are out of order");
+    }
+    while(position() < offset){
+        if(available() == 0 && !fill(1)){
+            LOG.error("Input " + name_ + " ends before offset " + std::to_string(offset), "ContainerStream::skip_to");
+            throw std::runtime_error("Corrupted file: block is out of file bounds");
+        }
+        pos_ += static_cast<size_t>(std::min<uint64_t>(available(), offset - position()));
+    }
+}
+
+uint64_t ContainerStream::decode(OutputBuffer& output){
+    uint64_t payload_bits = 0;
+    for(size_t i = 0; i < entries_.size(); ++i){
+        decode_block(i, output);
+        payload_bits += entries_[i].bit_count;
+    }
+    return payload_bits;
+}
+
+void ContainerStream::decode_block(size_t block, OutputBuffer& output){
+    const Container::BlockEntry& entry = entries_[block];
+    skip_to(entry.offset);
+    if(entry.raw_size == 0 && entry.bit_count == 0){
+        return;
+    }
+
+    // A code table is a few KiB at most
+    fill(CHUNK_SIZE);
+    std::array<Code, 256> codes;
+    pos_ += Container::read_codes(data(), available(), codes, header_.max_code_length);
+    const DecodeTable table(codes, DecodeTable::root_bits(header_.max_code_length));
+
+    if(header_.flags & Container::INTERLEAVED){
+        decode_lanes(block, table, output);
+        return;
+    }
+
+    // Windows of the payload end on whole bytes, codes cut by the window
+    // end are left for the next one together with the bits before them
+    const uint64_t payload_bytes = (entry.bit_count + 7) / 8;
+    const uint64_t start = output.total();
+    uint64_t done = 0;  // payload bytes already dropped from the window
+    uint64_t bit = 0;   // first unread bit of data()
+    while(true){
+        const uint64_t left = payload_bytes - done;
+        if(!fill(static_cast<size_t>(std::min<uint64_t>(left, CHUNK_SIZE)))){
+            LOG.error("Payload of block " + std::to_string(block) + " is truncated", "ContainerStream::decode_block");
+            throw std::runtime_error("Corrupted file: block is out of file bounds");
+        }
+        const size_t bytes = static_cast<size_t>(std::min<uint64_t>(left, available()));
+        const bool last = bytes == left;
+        const uint64_t end = last ? entry.bit_count - done * 8 : uint64_t{bytes} * 8;
+        const unsigned reserve = last ? 0 : table.max_length();
+
+        BitReader reader(data(), bytes, end, bit);
+        while(reader.bits_left() > 0 && reader.bits_left() >= reserve){
+            if(output.available() < DecodeTable::MAX_SYMBOLS){
+                output.flush();
+            }
+            output.commit(table.decode(reader, output.tail(), output.available(), reserve));
+        }
+        if(last){
+            pos_ += bytes;
+            break;
+        }
+        const size_t used = static_cast<size_t>(reader.position() / 8);
+        pos_ += used;
+        done += used;
+        bit = reader.position() % 8;
+    }
+
+    if(output.total() - start != entry.raw_size){
+        LOG.error("Block " + std::to_string(block) + " decoded to " + std::to_string(output.total() - start) +
+                  " symbols instead of " + std::to_string(entry.raw_size), "ContainerStream::decode_block");
+        throw std::runtime_error("Error in decode");
+    }
+}
+
+void ContainerStream::decode_lanes(size_t block, const DecodeTable& table, OutputBuffer& output){
+    const Container::BlockEntry& entry = entries_[block];
+    const size_t lane_count = header_.lanes;
+
+    // Every lane is needed from the first round, so the whole payload is buffered
+    if(!fill(8 * lane_count)){
+        LOG.error("Lane lengths of block " + std::to_string(block) + " are truncated", "ContainerStream::decode_lanes");
+        throw std::runtime_error("Corrupted file: block is out of file bounds");
+    }
+    const std::vector<Container::Lane> lanes =
+        Container::read_lanes(data(), std::numeric_limits<size_t>::max(), entry, header_.lanes);
+    const uint64_t payload_bytes = Container::lanes_size(lanes);
+    if(!fill(static_cast<size_t>(payload_bytes))){
+        LOG.error("Payload of block " + std::to_string(block) + " is truncated", "ContainerStream::decode_lanes");
+        throw std::runtime_error("Corrupted file: block is out of file bounds");
+    }
+
+    std::vector<BitReader> readers;
+    for(const Container::Lane& lane : lanes){
+        readers.emplace_back(data() + lane.offset, static_cast<size_t>((lane.bit_count + 7) / 8), lane.bit_count);
+    }
+    // Chunks of whole rounds, so every chunk starts again at the first lane
+    for(uint64_t left = entry.raw_size; left > 0;){
+        if(output.available() < lane_count){
+            output.flush();
+        }
+        const size_t count = left <= output.available() ? static_cast<size_t>(left)
+                                                        : output.available() / lane_count * lane_count;
+        table.decode_interleaved(readers.data(), header_.lanes, output.tail(), count);
+        output.commit(count);
+        left -= count;
+    }
+    for(const BitReader& reader : readers){
+        if(reader.bits_left() != 0){
+            LOG.error("Block " + std::to_string(block) + " has bits left after " + std::to_string(entry.raw_size) +
+                      " symbols", "ContainerStream::decode_lanes");
+            throw std::runtime_error("Error in decode");
+        }
+    }
+    pos_ += static_cast<size_t>(payload_bytes);
+}
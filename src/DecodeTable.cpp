@@ -0,0 +1,256 @@
+#include "DecodeTable.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#define LOG Logger::getInstance()
+
+DecodeTable::DecodeTable(const std::vector<std::pair<unsigned char, std::string>>& codes, unsigned bits)
+    : bits_(std::clamp(bits, 1u, MAX_BITS)){
+    build(codes);
+}
+
+DecodeTable::DecodeTable(const std::array<Code, 256>& codes, unsigned bits)
+    : bits_(std::clamp(bits, 1u, MAX_BITS)){
+    std::vector<std::pair<unsigned char, std::string>> alphabet;
+    for(size_t i = 0; i < codes.size(); ++i){
+        if(!codes[i].empty()){
+            alphabet.emplace_back(static_cast<unsigned char>(i), codes[i].to_string());
+        }
+    }
+    build(alphabet);
+}
+
+unsigned DecodeTable::root_bits(unsigned max_length){
+    if(max_length == 0 || max_length > 2 * SINGLE_LEVEL_BITS){
+        return DEFAULT_BITS;
+    }
+    return std::clamp(max_length, DEFAULT_BITS, SINGLE_LEVEL_BITS);
+}
+
+void DecodeTable::build(const std::vector<std::pair<unsigned char, std::string>>& codes){
+    if(codes.empty()){
+        LOG.error("Alphabet is empty", "DecodeTable::build");
+        throw std::runtime_error("DecodeTable: alphabet is empty");
+    }
+
+    // A lone symbol is emitted for every bit of the stream, whatever its value
+    static const std::string zero = "0", one = "1";
+    std::vector<CodeRef> group;
+    if(codes.size() == 1){
+        group.push_back({codes[0].first, &zero});
+        group.push_back({codes[0].first, &one});
+    }
+    else{
+        for(const auto& [symbol, code] : codes){
+            if(code.empty()){
+                LOG.error("Empty code for symbol " + std::to_string(symbol), "DecodeTable::build");
+                throw std::runtime_error("DecodeTable: empty code");
+            }
+            group.push_back({symbol, &code});
+            max_length_ = std::max(max_length_, static_cast<unsigned>(code.size()));
+        }
+    }
+    max_length_ = std::max(max_length_, 1u);
+
+    build_level(group, 0, bits_);
+    join_root_symbols();
+
+    LOG_DEBUG("Decode table built: {} bit root, {} entries", "DecodeTable::build", bits_, entries_.size());
+}
+
+uint32_t DecodeTable::build_level(const std::vector<CodeRef>& group, size_t offset, unsigned width){
+    const uint32_t start = static_cast<uint32_t>(entries_.size());
+    entries_.resize(entries_.size() + (size_t{1} << width));
+
+    // Codes that do not fit into this level, grouped by their index in it
+    std::map<uint32_t, std::vector<CodeRef>> longer;
+
+    for(const auto& ref : group){
+        const std::string& code = *ref.code;
+        const size_t len = code.size() - offset;
+
+        uint32_t index = 0;
+        for(size_t i = 0; i < std::min<size_t>(len, width); ++i){
+            char c = code[offset + i];
+            if(c != '0' && c != '1'){
+                LOG.error("Non-binary char in code " + code, "DecodeTable::build_level");
+                throw std::runtime_error("DecodeTable: non-binary char in code");
+            }
+            index = (index << 1) | static_cast<uint32_t>(c == '1');
+        }
+
+        if(len > width){
+            longer[index].push_back(ref);
+            continue;
+        }
+
+        // Every index starting with the code resolves to its symbol
+        const size_t first = static_cast<size_t>(index) << (width - len);
+        const size_t span = size_t{1} << (width - len);
+        for(size_t i = first; i < first + span; ++i){
+            Entry& entry = entries_[start + i];
+            if(entry.count != 0){
+                LOG.error("Code " + code + " conflicts with another code", "DecodeTable::build_level");
+                throw std::runtime_error("DecodeTable: alphabet is not a prefix code");
+            }
+            entry.symbols[0] = ref.symbol;
+            entry.count = 1;
+            entry.bits = static_cast<uint8_t>(len);
+            entry.first_bits = static_cast<uint8_t>(len);
+        }
+    }
+
+    for(const auto& [index, sub_group] : longer){
+        if(entries_[start + index].count != 0){
+            LOG.error("Code " + *sub_group.front().code + " conflicts with another code",
+                      "DecodeTable::build_level");
+            throw std::runtime_error("DecodeTable: alphabet is not a prefix code");
+        }
+
+        size_t max_len = 0;
+        for(const auto& ref : sub_group){
+            max_len = std::max(max_len, ref.code->size());
+        }
+        const unsigned sub_width = static_cast<unsigned>(
+            std::min<size_t>(bits_, max_len - offset - width));
+
+        // entries_ may be reallocated by the recursive call
+        const uint32_t sub = build_level(sub_group, offset + width, sub_width);
+        entries_[start + index].sub = sub;
+        entries_[start + index].sub_bits = static_cast<uint8_t>(sub_width);
+    }
+
+    return start;
+}
+
+void DecodeTable::join_root_symbols(){
+    const size_t size = size_t{1} << bits_;
+    const size_t mask = size - 1;
+    const std::vector<Entry> single(entries_.begin(), entries_.begin() + size);
+
+    for(size_t i = 0; i < size; ++i){
+        Entry& entry = entries_[i];
+        if(entry.count == 0) continue;
+
+        // Append following codes while they fit entirely into the remaining index bits
+        while(entry.count < MAX_SYMBOLS && entry.bits < bits_){
+            const Entry& next = single[(i << entry.bits) & mask];
+            if(next.count == 0 || next.bits > bits_ - entry.bits) break;
+            entry.symbols[entry.count++] = next.symbols[0];
+            entry.bits = static_cast<uint8_t>(entry.bits + next.bits);
+        }
+    }
+}
+
+unsigned char DecodeTable::decode_one(BitReader& reader) const{
+    uint32_t level = 0;
+    unsigned width = bits_;
+    while(true){
+        const uint64_t left = reader.bits_left();
+        const Entry& entry = entries_[level + reader.peek(width)];
+
+        if(entry.count != 0){
+            if(entry.first_bits > left){
+                LOG.error("Stream ends in the middle of a code", "DecodeTable::decode_one");
+                throw std::runtime_error("Error in decode");
+            }
+            reader.skip(entry.first_bits);
+            return entry.symbols[0];
+        }
+
+        if(entry.sub_bits == 0 || width > left){
+            LOG.error("Invalid code at bit " + std::to_string(reader.position()), "DecodeTable::decode_one");
+            throw std::runtime_error("Error in decode");
+        }
+        reader.skip(width);
+        level = entry.sub;
+        width = entry.sub_bits;
+    }
+}
+
+template<unsigned Lanes>
+size_t DecodeTable::decode_rounds(BitReader* readers, unsigned char* out, size_t rounds) const{
+    const Entry* root = entries_.data();
+    BitReader* lanes = readers;
+
+    size_t r = 0;
+    for(; r < rounds; ++r){
+        bool ahead = true;
+        for(unsigned s = 0; s < Lanes; ++s){
+            ahead &= lanes[s].bits_left() >= bits_;
+        }
+        if(!ahead){
+            break;
+        }
+        for(unsigned s = 0; s < Lanes; ++s){
+            const Entry& entry = root[lanes[s].peek(bits_)];
+            if(entry.count != 0){
+                out[s] = entry.symbols[0];
+                lanes[s].skip(entry.first_bits);
+            }
+            else{
+                out[s] = decode_one(lanes[s]);
+            }
+        }
+        out += Lanes;
+    }
+    return r;
+}
+
+void DecodeTable::decode_interleaved(BitReader* readers, unsigned lanes, unsigned char* out, size_t count) const{
+    const size_t rounds = count / lanes;
+    size_t done = 0;
+    switch(lanes){
+        case 2:
+            done = decode_rounds<2>(readers, out, rounds);
+            break;
+        case 4:
+            done = decode_rounds<4>(readers, out, rounds);
+            break;
+        case 8:
+            done = decode_rounds<8>(readers, out, rounds);
+            break;
+        default:
+            LOG.error("Invalid lane count " + std::to_string(lanes), "DecodeTable::decode_interleaved");
+            throw std::invalid_argument("Lane count must be 2, 4 or 8");
+    }
+
+    // Ends of the lanes, with bound checks
+    for(size_t i = done * lanes; i < count; ++i){
+        BitReader& reader = readers[i % lanes];
+        if(reader.bits_left() == 0){
+            LOG.error("Lane " + std::to_string(i % lanes) + " ends before symbol " + std::to_string(i),
+                      "DecodeTable::decode_interleaved");
+            throw std::runtime_error("Error in decode");
+        }
+        out[i] = decode_one(reader);
+    }
+}
+
+size_t DecodeTable::decode(BitReader& reader, unsigned char* out, size_t capacity, unsigned reserve) const{
+    const Entry* root = entries_.data();
+    const uint64_t ahead = std::max(bits_, reserve);
+    size_t n = 0;
+
+    // Whole root index is valid and out has room for any entry
+    while(n + MAX_SYMBOLS <= capacity && reader.bits_left() >= ahead){
+        const Entry& entry = root[reader.peek(bits_)];
+        if(entry.count != 0){
+            std::memcpy(out + n, entry.symbols, MAX_SYMBOLS);
+            n += entry.count;
+            reader.skip(entry.bits);
+        }
+        else{
+            out[n++] = decode_one(reader);
+        }
+    }
+
+    while(n < capacity && reader.bits_left() > 0 && reader.bits_left() >= reserve){
+        out[n++] = decode_one(reader);
+    }
+    return n;
+}
@@ -1,35 +1,98 @@
 #include "Decoder.hpp"
+#include "ContainerStream.hpp"
 #include "Logger.hpp"
+#include "OutputBuffer.hpp"
+#include "OutputFile.hpp"
+#include "ThreadPool.hpp"
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <limits>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 
 #define LOG Logger::getInstance()
 
 void Decoder::start(){
     LOG.info("Starting decoder for files: " + input_path_text_ + " and " + input_path_alphabet_, "Decoder::start");
 
-    std::ifstream input_alphabet(input_path_alphabet_);
-    if(!input_alphabet.is_open()){
-        LOG.error("Error in opening file " + input_path_alphabet_, "Decoder::start");
-        throw std::runtime_error("Error in opening file");
+    metrics_ = Metrics{};
+    metrics_.engine = "fano";
+    metrics_.operation = "decode";
+    std::vector<uint8_t> head;
+    {
+        PhaseTimer timer(metrics_, "read");
+        if(input_path_text_ != MappedFile::STDIN_PATH){
+            input_.open(input_path_text_);
+        }
+        else{
+            // A container on stdin is decoded as it arrives, anything else is read whole
+            head = stdin_head_ ? std::move(*stdin_head_) : ContainerStream::read_head(std::cin);
+            stdin_head_.reset();
+            if(!Container::is_container(head.data(), head.size())){
+                input_.open(std::cin, head, "stdin");
+            }
+        }
     }
+    metrics_.bytes_in = input_.size();
 
-    read_alphabet(input_alphabet);
-    if(match_vec_.empty()){
-        LOG.error("match_vec_ is empty", "Decoder::start");
-        throw std::runtime_error("Decoder::start: match_vec_ is empty");
+    const bool container = Container::is_container(input_.data(), input_.size());
+    if(!input_.is_open()){
+        stream_decode(std::move(head));
     }
+    else if(container || method_ == Method::Table){
+        if(container){
+            LOG.info("Input is a container, code tables are read from it", "Decoder::start");
+        }
+        if(pipeline_ && can_pipeline()){
+            LOG.info("Starting pipelined decoding", "Decoder::start");
+            pipeline_decode();
+        }
+        else{
+            load();
 
-    LOG.info("Building decoding tree", "Decoder::start");
-    tree_ = make_tree(0, match_vec_.size() - 1, 0);
+            LOG.info("Starting text decoding", "Decoder::start");
+            table_decode();
+        }
+    }
+    else{
+        PhaseTimer alphabet_timer(metrics_, "alphabet");
+        std::ifstream input_alphabet(input_path_alphabet_);
+        if(!input_alphabet.is_open()){
+            LOG.error("Error in opening file " + input_path_alphabet_, "Decoder::start");
+            throw std::runtime_error("Error in opening file");
+        }
+
+        read_alphabet(input_alphabet);
+        if(match_vec_.empty()){
+            LOG.error("match_vec_ is empty", "Decoder::start");
+            throw std::runtime_error("Decoder::start: match_vec_ is empty");
+        }
+        alphabet_timer.stop();
+
+        LOG.info("Building decoding tree", "Decoder::start");
+        PhaseTimer table_timer(metrics_, "table");
+        tree_.clear();
+        tree_.reserve(count_tree_nodes(match_vec_));
+        make_tree(match_vec_, tree_, 0, match_vec_.size() - 1, 0);
+        table_timer.stop();
+
+        LOG.info("Starting text decoding", "Decoder::start");
+        bit_decode();
+    }
 
-    LOG.info("Starting text decoding", "Decoder::start");
-    bit_decode();
+    LOG_INFO("Decoded {} bytes into {} bytes in {} s, {} MB/s", "Decoder::start",
+             metrics_.bytes_in, metrics_.bytes_out, metrics_.total_seconds, metrics_.throughput_mbps());
+    if(!metrics_path_.empty()){
+        metrics_.write_json(metrics_path_);
+    }
     LOG.info("Decoding completed successfully", "Decoder::start");
 }
 
@@ -45,7 +108,7 @@ void Decoder::read_alphabet(std::ifstream& input_file){
 
     input_file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     if(n == 0){
-        std::ofstream output_file(output_path_, std::ios::out | std::ios::trunc);
+        OutputFile output_file(output_path_);
         return;
     }
 
@@ -67,7 +130,7 @@ void Decoder::read_alphabet(std::ifstream& input_file){
         try {
             unsigned char symbol = parse_symbol_token(token);
             match_vec_.emplace_back(symbol, code);
-            LOG.debug("Symbol: " + token + " -> Code: " + code, "Decoder::read_alphabet");
+            LOG_DEBUG("Symbol: {} -> Code: {}", "Decoder::read_alphabet", token, code);
         } catch (const std::exception& e) {
             LOG.error("Failed to parse symbol token: " + token + " - " + e.what(), "Decoder::read_alphabet");
             throw;
@@ -81,47 +144,88 @@ void Decoder::read_alphabet(std::ifstream& input_file){
     LOG.info("Alphabet read and sorted successfully", "Decoder::read_alphabet");
 }
 
-std::unique_ptr<Node> Decoder::make_tree(size_t beg, size_t end, size_t rang){
+std::vector<Node> Decoder::build_tree(std::vector<std::pair<unsigned char, std::string>> codes){
+    if(codes.empty()){
+        LOG.error("Alphabet is empty", "Decoder::build_tree");
+        throw std::runtime_error("Decoder::build_tree: alphabet is empty");
+    }
+    std::sort(codes.begin(), codes.end(), [](auto const & p1, auto const & p2){
+        return p1.second < p2.second;
+    });
+
+    std::vector<Node> tree;
+    tree.reserve(count_tree_nodes(codes));
+    make_tree(codes, tree, 0, codes.size() - 1, 0);
+    return tree;
+}
+
+size_t Decoder::count_tree_nodes(const std::vector<std::pair<unsigned char, std::string>>& codes){
+    size_t count = 1;
+    for(size_t i = 0; i < codes.size(); ++i){
+        const std::string& code = codes[i].second;
+        size_t common = 0;
+        if(i > 0){
+            const std::string& prev = codes[i - 1].second;
+            while(common < code.size() && common < prev.size() && code[common] == prev[common]){
+                ++common;
+            }
+        }
+        count += code.size() - common;
+    }
+    return count;
+}
+
+uint16_t Decoder::make_tree(const std::vector<std::pair<unsigned char, std::string>>& codes, std::vector<Node>& tree,
+size_t beg, size_t end, size_t rang){
+
+    if(beg > end) return Node::NIL;
 
-    if(beg > end) return nullptr;
+    if(tree.size() > std::numeric_limits<uint16_t>::max()){
+        LOG.error("Too many nodes in decoding tree", "Decoder::make_tree");
+        throw std::runtime_error("Too many nodes in decoding tree");
+    }
+    const auto idx = static_cast<uint16_t>(tree.size());
+    tree.emplace_back();
 
     if(beg == end){
-        LOG.debug("Creating leaf node for symbol: " + std::string(1, match_vec_[beg].first),
-                 "Decoder::make_tree");
-        return std::make_unique<Node>(Node(match_vec_[beg].first, true));
+        LOG_DEBUG("Creating leaf node for symbol: {}", "Decoder::make_tree", static_cast<char>(codes[beg].first));
+        tree[idx].symbol = static_cast<char>(codes[beg].first);
+        tree[idx].is_leaf = true;
+        return idx;
     }
 
-    if(match_vec_[beg].second.size() <= rang){
+    if(codes[beg].second.size() <= rang){
         std::string error_msg = "Oversize rang " + std::to_string(rang) + " " +
-                               match_vec_[beg].second + " " + match_vec_[beg + 1].second;
+                               codes[beg].second + " " + codes[beg + 1].second;
         LOG.error(error_msg, "Decoder::make_tree");
         throw std::runtime_error(error_msg);
     }
 
-    size_t med = find_med(beg, end, rang);
-    auto node = std::make_unique<Node>(Node());
+    size_t med = find_med(codes, beg, end, rang);
 
-    LOG.debug("Creating node at range [" + std::to_string(beg) + "-" + std::to_string(end) +
-             "], median: " + std::to_string(med), "Decoder::make_tree");
+    LOG_DEBUG("Creating node at range [{}-{}], median: {}", "Decoder::make_tree", beg, end, med);
 
+    // Children are built first and linked after, tree grows during recursion
+    uint16_t left = Node::NIL;
+    uint16_t right = Node::NIL;
     if(med == beg){
-        node->left = nullptr;
-        node->right = make_tree(beg, end, rang + 1);
+        right = make_tree(codes, tree, beg, end, rang + 1);
     }
     else if(med == end + 1){
-        node->left = make_tree(beg, end, rang + 1);
-        node->right = nullptr;
+        left = make_tree(codes, tree, beg, end, rang + 1);
     }
     else{
-        node->left = make_tree(beg, med - 1, rang + 1);
-        node->right = make_tree(med, end, rang + 1);
+        left = make_tree(codes, tree, beg, med - 1, rang + 1);
+        right = make_tree(codes, tree, med, end, rang + 1);
     }
-    return node;
+    tree[idx].child[0] = left;
+    tree[idx].child[1] = right;
+    return idx;
 }
 
-size_t Decoder::find_med(size_t beg, size_t end, size_t rang){
+size_t Decoder::find_med(const std::vector<std::pair<unsigned char, std::string>>& codes, size_t beg, size_t end, size_t rang){
     for(size_t i = beg; i <= end; ++i){
-        if(rang < match_vec_[i].second.size() && match_vec_[i].second[rang] == '1'){
+        if(rang < codes[i].second.size() && codes[i].second[rang] == '1'){
             return i;
         }
     }
@@ -132,8 +236,8 @@ size_t Decoder::find_med(size_t beg, size_t end, size_t rang){
 }
 
 void Decoder::decode_text(std::ifstream& input_file){
-    if (!tree_) {
-        LOG.error("Decoding tree is nullptr", "Decoder::decode_text");
+    if (tree_.empty()) {
+        LOG.error("Decoding tree is empty", "Decoder::decode_text");
         throw std::runtime_error("Decoder::decode_text: decoding tree is not built");
     }
 
@@ -142,7 +246,7 @@ void Decoder::decode_text(std::ifstream& input_file){
         throw std::runtime_error("Decoder::decode_text: Error in opening file");
     }
 
-    std::ofstream output_file(output_path_);
+    std::ofstream output_file(output_path_, std::ios::binary);
     if(!output_file.is_open()){
         LOG.error("Error in opening file " + output_path_, "Decoder::decode_text");
         throw std::runtime_error("Decoder::decode_text: Error in opening file");
@@ -150,40 +254,37 @@ void Decoder::decode_text(std::ifstream& input_file){
 
     LOG.info("Starting text decoding", "Decoder::decode_text");
 
+    OutputBuffer output(output_file, static_cast<size_t>(cout_number));
     char ch;
-    size_t i = 0;
-    Node* cur_node = tree_.get();
+    const Node* nodes = tree_.data();
+    uint16_t cur = 0;
 
     while(input_file.get(ch)){
         if (ch != '0' && ch != '1') continue;
 
-        if(ch == '1'){
-            cur_node = cur_node->right.get();
-        }
-        else{
-            cur_node = cur_node->left.get();
-        }
+        cur = nodes[cur].child[ch == '1'];
 
-        if(!cur_node){
+        if(cur == Node::NIL){
             LOG.error("Null node encountered during decoding", "Decoder::decode_text");
             throw std::runtime_error("Error in decode");
         }
 
-        if(cur_node->is_leaf){
-            output_file.put(cur_node->symbol);
-            if(++i <= cout_number){
-                std::cout << cur_node->symbol;
-            }
-            cur_node = tree_.get();
+        if(nodes[cur].is_leaf){
+            output.put(static_cast<unsigned char>(nodes[cur].symbol));
+            cur = 0;
         }
     }
+    output.flush();
+    if(preview_){
+        std::cout << output.preview();
+    }
 
-    if(cur_node != tree_.get()){
+    if(cur != 0){
         LOG.error("Decoding ended in non-root node", "Decoder::decode_text");
         throw std::runtime_error("Error in decode");
     }
 
-    LOG.info("Text decoding completed. Symbols decoded: " + std::to_string(i),
+    LOG.info("Text decoding completed. Symbols decoded: " + std::to_string(output.total()),
              "Decoder::decode_text");
 }
 
@@ -196,7 +297,7 @@ unsigned char Decoder::parse_symbol_token(const std::string &token_raw) {
     std::string token = token_raw;
 
     if (token.size() == 1 && !std::isspace(static_cast<unsigned char>(token[0]))) {
-        LOG.debug("Parsed printable symbol: " + token, "Decoder::parse_symbol_token");
+        LOG_DEBUG("Parsed printable symbol: {}", "Decoder::parse_symbol_token", token);
         return static_cast<unsigned char>(token[0]);
     }
 
@@ -222,8 +323,7 @@ unsigned char Decoder::parse_symbol_token(const std::string &token_raw) {
                              "Decoder::parse_symbol_token");
                     throw std::runtime_error(std::string("unsupported escape: \\") + esc);
             }
-            LOG.debug("Parsed escape sequence: " + token + " -> " + std::to_string(result),
-                     "Decoder::parse_symbol_token");
+            LOG_DEBUG("Parsed escape sequence: {} -> {}", "Decoder::parse_symbol_token", token, result);
             return result;
         }
         else{
@@ -234,8 +334,7 @@ unsigned char Decoder::parse_symbol_token(const std::string &token_raw) {
                     LOG.error("Numeric symbol out of range: " + token, "Decoder::parse_symbol_token");
                     throw std::runtime_error("numeric symbol out of range 0..255");
                 }
-                LOG.debug("Parsed numeric symbol: " + token + " -> " + std::to_string(val),
-                        "Decoder::parse_symbol_token");
+                LOG_DEBUG("Parsed numeric symbol: {} -> {}", "Decoder::parse_symbol_token", token, val);
                 return static_cast<unsigned char>(val);
             }
         }
@@ -251,35 +350,50 @@ unsigned char Decoder::parse_symbol_token(const std::string &token_raw) {
 }
 
 void Decoder::bit_decode(){
-    std::ifstream input_file(input_path_text_, std::ios::binary);
-    if(!input_file.is_open()){
-        LOG.error("Error in opening file " + input_path_text_, "Decoder::bit_decode");
+    if(!input_.is_open()){
+        LOG.error("Input file " + input_path_text_ + " is not open", "Decoder::bit_decode");
         throw std::runtime_error("Error in opening file");
     }
 
-    std::ofstream output_file(output_path_);
-    if(!output_file.is_open()){
-        LOG.error("Error in opening file " + output_path_, "Decoder::bit_decode");
-        throw std::runtime_error("Error in opening file");
-    }
-
-    if(!tree_){
+    if(tree_.empty()){
         LOG.error("Tree is empty", "Decoder::bit_decode");
         throw std::runtime_error("Tree is emty");
     }
 
-    uint8_t padding = 0;
-    input_file.read(reinterpret_cast<char *>(&padding), sizeof(padding));
+    PhaseTimer decode_timer(metrics_, "decode");
+    OutputFile output_file(output_path_);
+    const auto data = input_.bytes();
+    const uint8_t padding = data.empty() ? 0 : data[0];
+
+    OutputBuffer output(output_file.stream(), static_cast<size_t>(cout_number));
+    tree_walk(tree_, data.empty() ? data : data.subspan(1), padding, output);
+    output.flush();
+    output_file.flush();
+    decode_timer.stop();
+    if(preview_ && !output_file.is_stdout()){
+        std::cout << output.preview();
+    }
 
-    Node* cur_node = tree_.get();
+    metrics_.bytes_out = metrics_.symbols = output.total();
+    metrics_.payload_bits = data.size() < 2 ? 0 : (data.size() - 1) * 8 - std::min<uint64_t>(padding, 8);
+}
+
+void Decoder::tree_walk(const std::vector<Node>& tree, std::span<const uint8_t> payload,
+unsigned padding, OutputBuffer& output){
+    if(padding > 7){
+        LOG.error("Invalid padding value", "Decoder::tree_walk");
+        throw std::runtime_error("Invalid padding value");
+    }
+    const Node* nodes = tree.data();
+    uint16_t cur = 0;
     uint8_t byte = 0;
     const uint8_t mask = 0x80; // 1000 0000
     const size_t BITS_IN_BYTE = 8;
     bool is_last = false;
-    size_t couted = 0;
 
-    while(input_file.read(reinterpret_cast<char *>(&byte), sizeof(byte))){
-        is_last = (input_file.peek() == EOF);
+    for(size_t pos = 0; pos < payload.size(); ++pos){
+        byte = payload[pos];
+        is_last = (pos + 1 == payload.size());
         size_t bits_to_read = BITS_IN_BYTE;
         if(is_last) bits_to_read -= padding;
 
@@ -288,29 +402,517 @@ void Decoder::bit_decode(){
             byte <<= 1;
 
 
-            if(cur_node->is_leaf){
-                output_file.put(cur_node->symbol);
-                if(++couted <= cout_number){
-                    std::cout << cur_node->symbol;
-                }
-                cur_node = tree_.get();
+            if(nodes[cur].is_leaf){
+                output.put(static_cast<unsigned char>(nodes[cur].symbol));
+                cur = 0;
                 continue;
             }
 
-            cur_node = bit ? cur_node->right.get() : cur_node->left.get();
+            cur = nodes[cur].child[bit];
 
-            if(!cur_node){
-                LOG.error("Null node encountered during decoding", "Decoder::decode_text");
+            if(cur == Node::NIL){
+                LOG.error("Null node encountered during decoding", "Decoder::tree_walk");
                 throw std::runtime_error("Error in decode");
             }
 
-            if(cur_node->is_leaf){
-                output_file.put(cur_node->symbol);
-                if(++couted <= cout_number){
-                    std::cout << cur_node->symbol;
+            if(nodes[cur].is_leaf){
+                output.put(static_cast<unsigned char>(nodes[cur].symbol));
+                cur = 0;
+            }
+        }
+    }
+}
+
+void Decoder::table_decode(){
+    PhaseTimer decode_timer(metrics_, "decode");
+    OutputFile output_file(output_path_);
+    for(const Stream& stream : streams_){
+        metrics_.payload_bits += stream.bit_count;
+    }
+
+    const bool indexed = std::any_of(streams_.begin(), streams_.end(),
+        [](const Stream& stream) { return stream.index.points.size() > 1; });
+    if((streams_.size() > 1 || indexed) && threads_ != 1){
+        parallel_decode(output_file);
+        return;
+    }
+
+    OutputBuffer output(output_file.stream(), static_cast<size_t>(cout_number));
+    for(const Stream& stream : streams_){
+        const uint64_t start = output.total();
+        if(!stream.lanes.empty()){
+            // Chunks of whole rounds, so every chunk starts again at the first lane
+            const size_t lanes = stream.lanes.size();
+            std::vector<BitReader> readers = lane_readers(stream);
+            for(uint64_t left = stream.symbols; left > 0;){
+                if(output.available() < lanes){
+                    output.flush();
                 }
-                cur_node = tree_.get();
+                const size_t count = left <= output.available() ? static_cast<size_t>(left)
+                                                                : output.available() / lanes * lanes;
+                stream.table->decode_interleaved(readers.data(), static_cast<unsigned>(lanes), output.tail(), count);
+                output.commit(count);
+                left -= count;
             }
+            if(std::any_of(readers.begin(), readers.end(), [](const BitReader& reader) { return reader.bits_left() != 0; })){
+                LOG.error("Interleaved stream has bits left after " + std::to_string(stream.symbols) + " symbols",
+                          "Decoder::table_decode");
+                throw std::runtime_error("Error in decode");
+            }
+            continue;
+        }
+        BitReader reader = stream_reader(stream);
+        while(reader.bits_left() > 0){
+            if(output.available() < DecodeTable::MAX_SYMBOLS){
+                output.flush();
+            }
+            output.commit(stream.table->decode(reader, output.tail(), output.available()));
         }
+        if(stream.symbols_known && output.total() - start != stream.symbols){
+            LOG.error("Stream decoded to " + std::to_string(output.total() - start) + " symbols instead of " +
+                      std::to_string(stream.symbols), "Decoder::table_decode");
+            throw std::runtime_error("Error in decode");
+        }
+    }
+    output.flush();
+    output_file.flush();
+    decode_timer.stop();
+    if(preview_ && !output_file.is_stdout()){
+        std::cout << output.preview();
     }
-}
\ No newline at end of file
+    metrics_.bytes_out = metrics_.symbols = output.total();
+
+    LOG.info("Text decoding completed. Symbols decoded: " + std::to_string(output.total()),
+             "Decoder::table_decode");
+}
+
+void Decoder::stream_decode(std::vector<uint8_t> head){
+    LOG.info("Input is a container on stdin, decoding blocks as they arrive", "Decoder::stream_decode");
+    PhaseTimer decode_timer(metrics_, "decode");
+    ContainerStream stream(std::cin, std::move(head), "stdin");
+    if(stream.header().engine != Container::Engine::Fano){
+        LOG.error("Container is not encoded with the Fano engine", "Decoder::stream_decode");
+        throw std::runtime_error("Container is not encoded with the Fano engine");
+    }
+
+    OutputFile output_file(output_path_);
+    OutputBuffer output(output_file.stream(), static_cast<size_t>(cout_number));
+    metrics_.payload_bits = stream.decode(output);
+    output.flush();
+    output_file.flush();
+    decode_timer.stop();
+    if(preview_ && !output_file.is_stdout()){
+        std::cout << output.preview();
+    }
+    metrics_.bytes_in = stream.position();
+    metrics_.bytes_out = metrics_.symbols = output.total();
+}
+
+void Decoder::load(){
+    if(!streams_.empty()){
+        return;
+    }
+    if(!input_.is_open()){
+        input_.open(input_path_text_);
+    }
+
+    if(Container::is_container(input_.data(), input_.size())){
+        load_container();
+    }
+    else{
+        load_stream();
+    }
+}
+
+void Decoder::load_stream(){
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
+    if(match_vec_.empty()){
+        std::ifstream input_alphabet(input_path_alphabet_);
+        if(!input_alphabet.is_open()){
+            LOG.error("Error in opening file " + input_path_alphabet_, "Decoder::load_stream");
+            throw std::runtime_error("Error in opening file");
+        }
+        read_alphabet(input_alphabet);
+        if(match_vec_.empty()){
+            LOG.error("match_vec_ is empty", "Decoder::load_stream");
+            throw std::runtime_error("Decoder::load_stream: match_vec_ is empty");
+        }
+    }
+
+    alphabet_timer.stop();
+
+    LOG.info("Building decoding table", "Decoder::load_stream");
+    PhaseTimer table_timer(metrics_, "table");
+    Stream stream;
+    stream.table = std::make_shared<DecodeTable>(match_vec_);
+    table_timer.stop();
+
+    // First byte is the number of padding bits in the last byte
+    const auto data = input_.bytes();
+    if(!data.empty()){
+        const uint8_t padding = data[0];
+        if(padding > 7){
+            LOG.error("Invalid padding value", "Decoder::load_stream");
+            throw std::runtime_error("Invalid padding value");
+        }
+        const uint64_t payload_bits = (data.size() - 1) * 8;
+        stream.payload = data.data() + 1;
+        stream.bytes = data.size() - 1;
+        stream.bit_count = payload_bits >= padding ? payload_bits - padding : 0;
+    }
+
+    const std::string index_path = SyncIndex::path_for(input_path_alphabet_);
+    if(std::filesystem::exists(index_path)){
+        SyncIndex index;
+        index.read(index_path);
+        if(index.total_bits != stream.bit_count){
+            LOG.warning("Sync index " + index_path + " does not match the stream, ignoring it",
+                        "Decoder::load_stream");
+        }
+        else{
+            LOG.info("Sync index loaded: " + std::to_string(index.points.size()) + " points",
+                     "Decoder::load_stream");
+            stream.symbols = index.total_symbols;
+            stream.symbols_known = true;
+            stream.index = std::move(index);
+        }
+    }
+    streams_.push_back(std::move(stream));
+}
+
+void Decoder::load_container(){
+    // Code tables are read and built block by block
+    PhaseTimer tables_timer(metrics_, "tables");
+    const uint8_t* data = input_.data();
+    const size_t size = input_.size();
+    const Container::Header header = Container::read_header(data, size);
+    if(header.engine != Container::Engine::Fano){
+        LOG.error("Container is not encoded with the Fano engine", "Decoder::load_container");
+        throw std::runtime_error("Container is not encoded with the Fano engine");
+    }
+
+    uint64_t output_offset = 0;
+    for(const auto& entry : Container::read_directory(data, size, header)){
+        Stream stream = block_stream(data + entry.offset, size - static_cast<size_t>(entry.offset), entry, header);
+        stream.output_offset = output_offset;
+        output_offset += entry.raw_size;
+        streams_.push_back(std::move(stream));
+    }
+
+    LOG.info("Container loaded: " + std::to_string(streams_.size()) + " blocks, " +
+             std::to_string(header.original_size) + " symbols", "Decoder::load_container");
+}
+
+Decoder::Stream Decoder::block_stream(const uint8_t* block, size_t size, const Container::BlockEntry& entry,
+const Container::Header& header){
+    std::array<Code, 256> codes;
+    const size_t table_size = Container::read_codes(block, size, codes, header.max_code_length);
+
+    const uint64_t payload_offset = table_size;
+    uint64_t payload_bytes = (entry.bit_count + 7) / 8;
+    std::vector<Container::Lane> lanes;
+    if(header.flags & Container::INTERLEAVED && payload_offset <= size){
+        lanes = Container::read_lanes(block + payload_offset, size - static_cast<size_t>(payload_offset), entry,
+                                      header.lanes);
+        payload_bytes = Container::lanes_size(lanes);
+    }
+    if(payload_offset > size || payload_bytes > size - payload_offset){
+        LOG.error("Block payload is out of file bounds", "Decoder::block_stream");
+        throw std::runtime_error("Corrupted file: block is out of file bounds");
+    }
+
+    Stream stream;
+    stream.payload = block + payload_offset;
+    stream.bytes = static_cast<size_t>(payload_bytes);
+    stream.bit_count = entry.bit_count;
+    stream.symbols = entry.raw_size;
+    stream.symbols_known = true;
+    stream.table = std::make_shared<DecodeTable>(codes, DecodeTable::root_bits(header.max_code_length));
+    stream.lanes = std::move(lanes);
+    if(header.flags & Container::SYNC_INDEX){
+        const uint64_t index_offset = payload_offset + payload_bytes;
+        Container::read_index(block + index_offset, size - static_cast<size_t>(index_offset), entry, stream.index);
+    }
+    return stream;
+}
+
+void Decoder::decode_whole(const Stream& stream, unsigned char* out){
+    const size_t symbols = static_cast<size_t>(stream.symbols);
+    if(!stream.lanes.empty()){
+        decode_lanes(stream, out, symbols);
+        return;
+    }
+    BitReader reader = stream_reader(stream);
+    const size_t decoded = stream.table->decode(reader, out, symbols);
+    if(decoded != symbols || reader.bits_left() != 0){
+        LOG.error("Block decoded to " + std::to_string(decoded) + " symbols instead of " + std::to_string(symbols),
+                  "Decoder::decode_whole");
+        throw std::runtime_error("Error in decode");
+    }
+}
+
+bool Decoder::can_pipeline() const{
+    if(!Pipeline::supported() || input_path_text_ == MappedFile::STDIN_PATH || OutputFile::is_stdout_path(output_path_)){
+        LOG.info("Pipeline needs positional input and output files, decoding as usual", "Decoder::can_pipeline");
+        return false;
+    }
+    if(!Container::is_container(input_.data(), input_.size())){
+        return false;
+    }
+    const Container::Header header = Container::read_header(input_.data(), input_.size());
+    if(!(header.flags & Container::BLOCKED)){
+        LOG.info("Pipeline needs a blocked container, decoding as usual", "Decoder::can_pipeline");
+        return false;
+    }
+    return true;
+}
+
+void Decoder::pipeline_decode(){
+    // Only the header and the directory are read through the mapping
+    const uint8_t* data = input_.data();
+    const size_t size = input_.size();
+    const Container::Header header = Container::read_header(data, size);
+    if(header.engine != Container::Engine::Fano){
+        LOG.error("Container is not encoded with the Fano engine", "Decoder::pipeline_decode");
+        throw std::runtime_error("Container is not encoded with the Fano engine");
+    }
+    const std::vector<Container::BlockEntry> entries = Container::read_directory(data, size, header);
+
+    // A block runs up to the next one, the last one to the end of the file
+    std::vector<Pipeline::Range> ranges(entries.size());
+    std::vector<uint64_t> output_offsets(entries.size());
+    uint64_t output_offset = 0;
+    for(size_t i = 0; i < entries.size(); ++i){
+        const uint64_t end = i + 1 < entries.size() ? entries[i + 1].offset : size;
+        if(end < entries[i].offset){
+            LOG.error("Block " + std::to_string(i + 1) + " overlaps the previous one", "Decoder::pipeline_decode");
+            throw std::runtime_error("Corrupted file: blocks are out of order");
+        }
+        ranges[i] = {entries[i].offset, static_cast<size_t>(end - entries[i].offset)};
+        output_offsets[i] = output_offset;
+        output_offset += entries[i].raw_size;
+        metrics_.payload_bits += entries[i].bit_count;
+    }
+    if(output_offset != header.original_size){
+        LOG.error("Blocks hold " + std::to_string(output_offset) + " bytes instead of " +
+                  std::to_string(header.original_size), "Decoder::pipeline_decode");
+        throw std::runtime_error("Corrupted file: block sizes do not add up");
+    }
+
+    PhaseTimer decode_timer(metrics_, "decode");
+    std::string preview;
+    Pipeline pipeline(input_path_text_, output_path_, header.original_size, pipeline_io_);
+    pipeline.run(ranges, [&](const Pipeline::Buffer& in, Pipeline::Buffer& out) {
+        const Container::BlockEntry& entry = entries[in.index];
+        if(entry.raw_size == 0){
+            return;
+        }
+        const Stream stream = block_stream(in.data.data(), in.data.size(), entry, header);
+        out.data.resize(static_cast<size_t>(entry.raw_size));
+        decode_whole(stream, out.data.data());
+        out.offset = output_offsets[in.index];
+        if(preview.size() < static_cast<size_t>(cout_number)){
+            preview.append(out.data.begin(), out.data.begin() +
+                static_cast<std::ptrdiff_t>(std::min(out.data.size(), cout_number - preview.size())));
+        }
+    });
+    pipeline.close();
+    decode_timer.stop();
+    if(preview_){
+        std::cout << preview;
+    }
+
+    metrics_.add_phase("read_io", pipeline.read_seconds());
+    metrics_.add_phase("write_io", pipeline.write_seconds());
+    metrics_.add_phase("stall", pipeline.stall_seconds());
+    metrics_.bytes_out = metrics_.symbols = header.original_size;
+
+    LOG.info("Pipelined decoding completed. Blocks: " + std::to_string(entries.size()) + ", symbols: " +
+             std::to_string(header.original_size) + ", I/O " + Pipeline::name(pipeline.io()), "Decoder::pipeline_decode");
+}
+
+BitReader Decoder::stream_reader(const Stream& stream){
+    return BitReader(stream.payload, stream.bytes, stream.bit_count);
+}
+
+std::vector<BitReader> Decoder::lane_readers(const Stream& stream){
+    std::vector<BitReader> readers;
+    readers.reserve(stream.lanes.size());
+    for(const Container::Lane& lane : stream.lanes){
+        readers.emplace_back(stream.payload + lane.offset, static_cast<size_t>((lane.bit_count + 7) / 8), lane.bit_count);
+    }
+    return readers;
+}
+
+void Decoder::decode_lanes(const Stream& stream, unsigned char* out, size_t count){
+    std::vector<BitReader> readers = lane_readers(stream);
+    stream.table->decode_interleaved(readers.data(), static_cast<unsigned>(readers.size()), out, count);
+    if(count == stream.symbols &&
+       std::any_of(readers.begin(), readers.end(), [](const BitReader& reader) { return reader.bits_left() != 0; })){
+        LOG.error("Interleaved stream has bits left after " + std::to_string(count) + " symbols", "Decoder::decode_lanes");
+        throw std::runtime_error("Error in decode");
+    }
+}
+
+std::vector<unsigned char> Decoder::decode_part(const Range& range) const{
+    const Stream& stream = streams_[range.stream];
+    const auto& points = stream.index.points;
+
+    // Interleaved streams have no index, the range is always the whole stream
+    if(!stream.lanes.empty()){
+        std::vector<unsigned char> out(static_cast<size_t>(stream.symbols));
+        decode_lanes(stream, out.data(), out.size());
+        return out;
+    }
+
+    BitReader reader = stream_reader(stream);
+    uint64_t begin = 0;
+    uint64_t end = stream.symbols;
+    uint64_t stop = stream.bit_count;
+    if(!points.empty()){
+        begin = points[range.first].output_offset;
+        reader.seek(points[range.first].bit_offset);
+        if(range.last < points.size()){
+            end = points[range.last].output_offset;
+            stop = points[range.last].bit_offset;
+        }
+    }
+
+    std::vector<unsigned char> out(static_cast<size_t>(end - begin));
+    const size_t decoded = stream.table->decode(reader, out.data(), out.size());
+    if(decoded != out.size() || reader.position() != stop){
+        LOG.error("Stream " + std::to_string(range.stream) + ", sync points " + std::to_string(range.first) + "-" +
+                  std::to_string(range.last) + " do not match the stream", "Decoder::decode_part");
+        throw std::runtime_error("Error in decode");
+    }
+    return out;
+}
+
+std::vector<Decoder::Range> Decoder::make_ranges(size_t tasks) const{
+    size_t points = 0;
+    for(const Stream& stream : streams_){
+        points += std::max<size_t>(1, stream.index.points.size());
+    }
+    const size_t per_task = std::max<size_t>(1, points / std::max<size_t>(1, tasks));
+
+    std::vector<Range> ranges;
+    for(size_t i = 0; i < streams_.size(); ++i){
+        const size_t count = streams_[i].index.points.size();
+        if(count == 0){
+            ranges.push_back({i, 0, 0});
+            continue;
+        }
+        for(size_t first = 0; first < count; first += per_task){
+            ranges.push_back({i, first, std::min(first + per_task, count)});
+        }
+    }
+    return ranges;
+}
+
+std::vector<unsigned char> Decoder::decode_range(uint64_t begin, uint64_t end){
+    load();
+    if(begin > end){
+        LOG.error("Invalid range " + std::to_string(begin) + "-" + std::to_string(end), "Decoder::decode_range");
+        throw std::invalid_argument("Invalid range");
+    }
+
+    std::vector<unsigned char> out;
+    out.reserve(static_cast<size_t>(end - begin));
+    for(const Stream& stream : streams_){
+        const uint64_t stream_end = stream.symbols_known ? stream.output_offset + stream.symbols
+                                                         : std::numeric_limits<uint64_t>::max();
+        if(out.size() == end - begin || stream_end <= begin){
+            continue;
+        }
+        const uint64_t from = std::max(begin, stream.output_offset) - stream.output_offset;
+        const uint64_t to = std::min(end, stream_end) - stream.output_offset;
+
+        // Symbols of an interleaved stream are spread over all lanes, it is decoded from its start
+        if(!stream.lanes.empty()){
+            std::vector<unsigned char> part(static_cast<size_t>(to));
+            decode_lanes(stream, part.data(), part.size());
+            out.insert(out.end(), part.begin() + static_cast<std::ptrdiff_t>(from), part.end());
+            continue;
+        }
+
+        // Without an index the only sync point is the start of the stream
+        BitReader reader = stream_reader(stream);
+        uint64_t position = 0;
+        if(!stream.index.empty()){
+            const auto& point = stream.index.points[stream.index.find(from)];
+            reader.seek(point.bit_offset);
+            position = point.output_offset;
+        }
+
+        std::vector<unsigned char> part(static_cast<size_t>(to - position));
+        const size_t decoded = stream.table->decode(reader, part.data(), part.size());
+        if(decoded != part.size()){
+            break;
+        }
+        out.insert(out.end(), part.begin() + static_cast<std::ptrdiff_t>(from - position), part.end());
+    }
+
+    if(out.size() != end - begin){
+        LOG.error("Range end " + std::to_string(end) + " is past the end of the stream", "Decoder::decode_range");
+        throw std::out_of_range("Range is past the end of the stream");
+    }
+    return out;
+}
+
+void Decoder::parallel_decode(OutputFile& output){
+    std::ostream& output_file = output.stream();
+    std::deque<std::future<std::vector<unsigned char>>> in_flight;
+    std::string preview;
+    uint64_t total = 0;
+
+    // Declared last so that its destructor waits for tasks still in flight
+    ThreadPool pool(threads_);
+    const size_t window = 2 * static_cast<size_t>(pool.size());
+    // A few ranges per thread, so one slow range does not idle the others
+    const std::vector<Range> ranges = make_ranges(4 * pool.size());
+
+    auto write_next = [&](){
+        const std::vector<unsigned char> part = in_flight.front().get();
+        in_flight.pop_front();
+        if(preview.size() < static_cast<size_t>(cout_number)){
+            preview.append(part.begin(), part.begin() +
+                static_cast<std::ptrdiff_t>(std::min(part.size(), cout_number - preview.size())));
+        }
+        output_file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+        if(!output_file){
+            LOG.error("Error in writing file " + output_path_, "Decoder::parallel_decode");
+            throw std::runtime_error("Error in writing file");
+        }
+        total += part.size();
+    };
+
+    for(const Range& range : ranges){
+        in_flight.push_back(pool.submit([this, range]() { return decode_part(range); }));
+        if(in_flight.size() >= window){
+            write_next();
+        }
+    }
+    while(!in_flight.empty()){
+        write_next();
+    }
+    // Container blocks know their sizes, which add up to the original size
+    if(std::all_of(streams_.begin(), streams_.end(), [](const Stream& stream) { return stream.symbols_known; })){
+        uint64_t expected = 0;
+        for(const Stream& stream : streams_){
+            expected += stream.symbols;
+        }
+        if(total != expected){
+            LOG.error("Blocks hold " + std::to_string(total) + " bytes instead of " + std::to_string(expected),
+                      "Decoder::parallel_decode");
+            throw std::runtime_error("Corrupted file: decoded size does not match");
+        }
+    }
+    output.flush();
+    if(preview_ && !output.is_stdout()){
+        std::cout << preview;
+    }
+    metrics_.bytes_out = metrics_.symbols = total;
+
+    LOG.info("Parallel decoding completed. Ranges: " + std::to_string(ranges.size()) +
+             ", symbols: " + std::to_string(total), "Decoder::parallel_decode");
+}
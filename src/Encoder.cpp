@@ -1,10 +1,18 @@
 #include "Encoder.hpp"
+#include "BitWriter.hpp"
+#include "Container.hpp"
+#include "Histogram.hpp"
 #include "Logger.hpp"
+#include "OutputFile.hpp"
+#include "SyncIndex.hpp"
+#include "ThreadPool.hpp"
 #include <algorithm>
-#include <cmath>
 #include <cstddef>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <ostream>
 #include <stdexcept>
 #include <string>
@@ -14,122 +22,114 @@
 void Encoder::start() {
     LOG.info("Starting encoder for file: " + input_path_, "Encoder::start");
 
-    compute_prob();
-    if (prob_vec_.empty()) {
-        LOG.error("prob_vec_ is empty", "Encoder::start");
-        throw std::runtime_error("Encoder::start: prob_vec_ is empty");
+    metrics_ = Metrics{};
+    metrics_.engine = "fano";
+    metrics_.operation = "encode";
+    {
+        PhaseTimer timer(metrics_, "read");
+        input_.open(input_path_);
     }
-
-    LOG.info("Building Fano dictionary", "Encoder::start");
-    if(prob_vec_.size() == 1){
-        dict_[prob_vec_[0].first] = "1";
-    }
-    else{
-        fill_dict(0, prob_vec_.size() - 1);
+    metrics_.bytes_in = input_.size();
+    metrics_.symbols = input_.size();
+    check_streams();
+
+    if (block_size_ != 0) {
+        if (pipeline_ && can_pipeline()) {
+            LOG.info("Starting pipelined encoding, block size " + std::to_string(block_size_), "Encoder::start");
+            pipeline_encode();
+        }
+        else {
+            LOG.info("Starting blocked encoding, block size " + std::to_string(block_size_), "Encoder::start");
+            block_encode();
+        }
     }
+    else {
+        compute_prob();
+        if (container_) {
+            LOG.info("Starting container encoding", "Encoder::start");
+            container_encode();
+        }
+        else {
+            if (table_.empty()) {
+                LOG.error("Code table is empty", "Encoder::start");
+                throw std::runtime_error("Encoder::start: code table is empty");
+            }
 
-    LOG.info("Starting text encoding", "Encoder::start");
-    bit_encode();
+            LOG.info("Starting text encoding", "Encoder::start");
+            bit_encode();
+        }
+    }
 
+    LOG_INFO("Encoded {} bytes into {} bytes in {} s, {} MB/s", "Encoder::start",
+             metrics_.bytes_in, metrics_.bytes_out, metrics_.total_seconds, metrics_.throughput_mbps());
+    if (!metrics_path_.empty()) {
+        metrics_.write_json(metrics_path_);
+    }
     LOG.info("Encoding completed successfully", "Encoder::start");
 }
 
+void Encoder::check_streams() const {
+    if (streams_ == 1) {
+        return;
+    }
+    if (!Container::valid_lanes(streams_)) {
+        LOG.error("Invalid stream count " + std::to_string(streams_), "Encoder::check_streams");
+        throw std::invalid_argument("Stream count must be 1, 2, 4 or 8");
+    }
+    if (sync_interval_ != 0 || (!container_ && block_size_ == 0)) {
+        LOG.error("Interleaved streams need the container and no sync index", "Encoder::check_streams");
+        throw std::invalid_argument("Interleaved streams need the container and no sync index");
+    }
+}
+
 void Encoder::compute_prob() {
-    auto total = static_cast<double>(compute_frec());
+    PhaseTimer histogram_timer(metrics_, "histogram");
+    auto total = compute_frec();
+    histogram_timer.stop();
     if (total == 0) {
         LOG.warning("Total symbols count is 0", "Encoder::compute_prob");
         return;
     }
 
-    LOG.info("Computing probabilities for " + std::to_string(total) + " symbols",
+    LOG.info("Building Fano dictionary for " + std::to_string(total) + " symbols",
              "Encoder::compute_prob");
 
-    for (size_t i = 0; i < frec_dict_.size(); ++i) {
-        if (frec_dict_[i] != 0) {
-            prob_vec_.push_back({static_cast<unsigned char>(i), frec_dict_[i] / total});
-        }
-    }
-
-    if (prob_vec_.size() == 1) {
-        LOG.info("Only one unique symbol found", "Encoder::compute_prob");
-        dict_[prob_vec_[0].first] = "0";
-        return;
-    }
+    metrics_.entropy = Metrics::entropy_of(frec_dict_);
 
-    std::sort(prob_vec_.begin(), prob_vec_.end(), [](auto &a, auto &b) { return a.second > b.second; });
+    PhaseTimer table_timer(metrics_, "table");
+    table_.build(frec_dict_, max_code_length_);
+    table_timer.stop();
 
     LOG.info("Probability computation completed. Unique symbols: " +
-             std::to_string(prob_vec_.size()), "Encoder::compute_prob");
+             std::to_string(table_.size()), "Encoder::compute_prob");
 }
 
-unsigned Encoder::compute_frec() {
-    std::ifstream file;
-    file.open(input_path_);
-    if (!file.is_open()) {
-        LOG.error("Error in opening file " + input_path_, "Encoder::compute_frec");
+uint64_t Encoder::compute_frec() {
+    if (!input_.is_open()) {
+        LOG.error("Input file " + input_path_ + " is not open", "Encoder::compute_frec");
         throw std::runtime_error("Error in opening file");
     }
 
-    char ch;
-    unsigned count = 0;
-    while (file.get(ch)) {
-        ++frec_dict_[ch];
-        ++count;
-    }
+    Histogram histogram(threads_);
+    frec_dict_ = histogram.count(input_.bytes());
+    const uint64_t count = input_.size();
 
     LOG.info("Frequency computed. Total symbols: " + std::to_string(count),
              "Encoder::compute_frec");
     return count;
 }
 
-void Encoder::fill_dict(size_t beg, size_t end){
-    if(end > beg){
-        auto med = find_med(beg, end);
-        for(size_t i = beg; i <= end; ++i){
-            dict_[prob_vec_[i].first] += std::to_string(static_cast<int>((i >= med)));
-        }
-        fill_dict(beg, med - 1);
-        fill_dict(med, end);
-    }
-}
-
-size_t Encoder::find_med(size_t beg, size_t end) {
-    if (beg == end) {
-        return beg;
-    }
-
-    double right_sum = 0;
-    for (auto i = beg + 1; i <= end; ++i) {
-        right_sum += prob_vec_[i].second;
-    }
-    double left_sum = prob_vec_[beg].second;
-    size_t med = beg;
-
-    auto dif = fabs(left_sum - right_sum);
-    do {
-        dif = fabs(left_sum - right_sum);
-        ++med;
-        left_sum += prob_vec_[med].second;
-        right_sum -= prob_vec_[med].second;
-    } while (med < end && dif > fabs(left_sum - right_sum));
-
-    LOG.debug("Found median: " + std::to_string(med) + " for range [" +
-              std::to_string(beg) + "-" + std::to_string(end) + "]",
-              "Encoder::find_med");
-
-    return med;
-}
-
 void Encoder::write_alphabet(std::ofstream &output_file) {
-    output_file << prob_vec_.size() << std::endl;
-    LOG.info("Writing alphabet with " + std::to_string(prob_vec_.size()) + " symbols",
+    output_file << table_.size() << std::endl;
+    LOG.info("Writing alphabet with " + std::to_string(table_.size()) + " symbols",
              "Encoder::write_alphabet");
 
-    for (size_t i = 0; i < dict_.size(); ++i) {
-        if (dict_[i] != "") {
-            output_file << format_symbol(static_cast<unsigned char>(i)) << " " << dict_[i] << std::endl;
-            LOG.debug("Symbol: " + format_symbol(static_cast<unsigned char>(i)) + " -> Code: " + dict_[i],
-                      "Encoder::write_alphabet");
+    const auto& dict = table_.codes();
+    for (size_t i = 0; i < dict.size(); ++i) {
+        if (!dict[i].empty()) {
+            output_file << format_symbol(static_cast<unsigned char>(i)) << " " << dict[i].to_string() << std::endl;
+            LOG_DEBUG("Symbol: {} -> Code: {}", "Encoder::write_alphabet",
+                      format_symbol(static_cast<unsigned char>(i)), dict[i]);
         }
     }
 }
@@ -152,10 +152,8 @@ std::string Encoder::format_symbol(unsigned char c) {
 }
 
 void Encoder::text_encode() {
-    std::ifstream input_file;
-    input_file.open(input_path_);
-    if (!input_file.is_open()) {
-        LOG.error("Error in opening input file " + input_path_, "Encoder::text_encode");
+    if (!input_.is_open()) {
+        LOG.error("Input file " + input_path_ + " is not open", "Encoder::text_encode");
         throw std::runtime_error("Error in opening file");
     }
 
@@ -174,25 +172,22 @@ void Encoder::text_encode() {
     }
 
     write_alphabet(output_alphabet);
-    char ch;
     int i = -1;
     size_t encoded_count = 0;
 
-    while (input_file.get(ch)) {
-        unsigned char u_ch = static_cast<unsigned char>(ch);
-        std::string &code = dict_[u_ch];
+    for (unsigned char u_ch : input_.bytes()) {
+        const Code &code = table_[u_ch];
         if (code.empty()) {
             LOG.error("No code found for symbol: " + std::to_string(u_ch), "Encoder::text_encode");
             throw std::runtime_error("Error in encoding");
         }
-        if (++i < cout_number) {
-            std::cout << dict_[u_ch];
+        if (preview_ && ++i < cout_number) {
+            std::cout << code.to_string();
         }
-        output_text << dict_[u_ch];
+        output_text << code.to_string();
         encoded_count++;
     }
 
-    input_file.close();
     output_text.close();
 
     LOG.info("Text encoding completed. Symbols encoded: " + std::to_string(encoded_count),
@@ -283,72 +278,441 @@ void Encoder::convert_to_binary() {
 
 
 void Encoder::bit_encode(){
-    std::ifstream input_file(input_path_);
-    if(!input_file.is_open()){
-        LOG.error("Error in opening input file " + input_path_, "Encoder::bit_encode");
+    if(!input_.is_open()){
+        LOG.error("Input file " + input_path_ + " is not open", "Encoder::bit_encode");
         throw std::runtime_error("Error in opening file");
     }
 
+    // Padding is patched into byte 0 after the payload, which needs a seekable file
+    if(OutputFile::is_stdout_path(output_path_text_)){
+        LOG.error("Legacy format cannot be written to stdout, use the container", "Encoder::bit_encode");
+        throw std::runtime_error("Legacy format needs a seekable output");
+    }
+
     std::ofstream output_text(output_path_text_, std::ios::binary);
     if(!output_text.is_open()){
         LOG.error("Error in opening output file " + output_path_text_, "Encoder::bit_encode");
         throw std::runtime_error("Error in opening file");
     }
 
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
     std::ofstream output_alphabet(output_path_alphabet_);
     if(!output_alphabet.is_open()){
         LOG.error("Error in opening output file " + output_path_alphabet_, "Encoder::bit_encode");
         throw std::runtime_error("Error in opening file");
     }
     write_alphabet(output_alphabet);
+    alphabet_timer.stop();
 
+    PhaseTimer encode_timer(metrics_, "encode");
     uint8_t padding = 0;
     output_text.put(static_cast<char>(padding));
 
-    uint8_t current = 0;
-    size_t filled = 0;
+    BitWriter writer(output_text);
 
-    char ch;
-    size_t printed = 0;
-    while(input_file.get(ch)){
-        unsigned char u_ch = static_cast<unsigned char>(ch);
-        if(u_ch >= dict_.size()){
-            LOG.error("Error symbol is out of range: " + std::to_string(static_cast<char>(u_ch)), "Encoder::bit_encode");
-            throw std::runtime_error("Symbol is out of range");
+    print_preview(input_.bytes(), table_.codes());
+
+    SyncIndex index;
+    encode_span(input_.bytes(), table_.codes(), writer, sync_interval_, index);
+    padding = writer.finish();
+
+    // Записать padding в начало файла
+    output_text.seekp(0, std::ios::beg);
+    output_text.put(static_cast<char>(padding));
+    output_text.flush();
+    encode_timer.stop();
+
+    metrics_.payload_bits = index.total_bits;
+    metrics_.bytes_out = 1 + (index.total_bits + 7) / 8;
+
+    if(sync_interval_ != 0){
+        index.write(SyncIndex::path_for(output_path_alphabet_));
+    }
+}
+
+void Encoder::container_encode(){
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
+    OutputFile output(output_path_text_);
+    std::ostream& output_text = output.stream();
+
+    const auto data = input_.bytes();
+
+    Container::Header header;
+    header.engine = Container::Engine::Fano;
+    header.flags = sync_interval_ != 0 ? Container::SYNC_INDEX : 0;
+    header.flags |= streams_ > 1 ? Container::INTERLEAVED : 0;
+    header.max_code_length = static_cast<uint8_t>(max_code_length_);
+    header.original_size = data.size();
+    header.block_size = data.size();
+    header.block_count = data.empty() ? 0 : 1;
+    header.lanes = static_cast<uint8_t>(streams_);
+
+    // Sizes are known from the table, so the header goes first and the payload is never patched
+    std::vector<uint8_t> head;
+    std::vector<uint8_t> codes;
+    std::vector<uint64_t> lanes;
+    Container::write_header(head, header);
+    if(!data.empty()){
+        Container::write_codes(codes, table_.codes());
+        const uint64_t offset = Container::HEADER_SIZE + Container::ENTRY_SIZE;
+        Container::write_directory(head, {{offset, data.size(), table_.encoded_bits(frec_dict_)}});
+        if(streams_ > 1){
+            lanes = lane_bits(data, table_.codes(), streams_);
         }
-        std::string & code = dict_[u_ch];
-        if(code.empty()){
-            LOG.error("Error no such symbol in dictionary: " + std::to_string(u_ch), "Encoder::bit_encode");
-            throw std::runtime_error("No such symbol in dictionary");
+    }
+    output_text.write(reinterpret_cast<const char*>(head.data()), static_cast<std::streamsize>(head.size()));
+    output_text.write(reinterpret_cast<const char*>(codes.data()), static_cast<std::streamsize>(codes.size()));
+    alphabet_timer.stop();
+
+    if(!output.is_stdout()){
+        print_preview(data, table_.codes());
+    }
+
+    PhaseTimer encode_timer(metrics_, "encode");
+    SyncIndex index;
+    if(!data.empty()){
+        BitWriter writer(output_text);
+        if(streams_ > 1){
+            encode_interleaved(data, table_.codes(), writer, lanes);
+            index.total_bits = table_.encoded_bits(frec_dict_);
         }
-        if(printed < static_cast<size_t>(cout_number)){
-            std::cout << code;
-            ++printed;
+        else{
+            encode_span(data, table_.codes(), writer, sync_interval_, index);
         }
+        writer.finish();
+    }
+
+    std::vector<uint8_t> tail;
+    if(header.flags & Container::SYNC_INDEX && !data.empty()){
+        Container::write_index(tail, index);
+        output_text.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail.size()));
+    }
+    output.flush();
+    encode_timer.stop();
 
-        for(char cb : code){
-            uint8_t bit = (cb == '1') ? 1 : 0;
-            current = static_cast<uint8_t>((current << 1) | bit);
-            ++filled;
+    metrics_.payload_bits = index.total_bits;
+    const uint64_t payload_bytes = streams_ > 1 ? Container::interleaved_size(lanes) : (index.total_bits + 7) / 8;
+    metrics_.bytes_out = head.size() + codes.size() + payload_bytes + tail.size();
+}
 
-            if(filled == 8){
-                output_text.put(static_cast<char>(current));
-                current = 0;
-                filled = 0;
+void Encoder::encode_span(std::span<const uint8_t> data, const std::array<Code, 256>& codes,
+BitWriter& writer, uint64_t interval, SyncIndex& index){
+    index.interval = interval;
+    const uint64_t start_bits = writer.bit_count();
+
+    // Chunks of interval symbols, each starting at a sync point
+    const size_t step = interval != 0 ? static_cast<size_t>(std::min<uint64_t>(interval, data.size())) : data.size();
+    for(size_t begin = 0; begin < data.size(); begin += step){
+        if(interval != 0){
+            index.points.push_back({writer.bit_count() - start_bits, begin});
+        }
+        for(unsigned char u_ch : data.subspan(begin, std::min(step, data.size() - begin))){
+            const Code& code = codes[u_ch];
+            if(code.empty()){
+                LOG.error("Error no such symbol in dictionary: " + std::to_string(u_ch), "Encoder::encode_span");
+                throw std::runtime_error("No such symbol in dictionary");
             }
+            writer.put(code);
         }
     }
 
-    if(filled != 0){
-        uint8_t pad = static_cast<uint8_t>(8 - filled);
-        current = static_cast<uint8_t>(current << pad);
-        output_text.put(static_cast<char>(current));
-        padding = pad;
-    } else {
-        padding = 0;
+    index.total_symbols = data.size();
+    index.total_bits = writer.bit_count() - start_bits;
+}
+
+std::vector<uint64_t> Encoder::lane_bits(std::span<const uint8_t> data, const std::array<Code, 256>& codes,
+unsigned streams){
+    std::vector<uint64_t> bits(streams);
+    for(size_t i = 0; i < data.size(); ++i){
+        bits[i % streams] += codes[data[i]].length;
     }
+    return bits;
+}
 
-    // Записать padding в начало файла
-    output_text.seekp(0, std::ios::beg);
-    output_text.put(static_cast<char>(padding));
+void Encoder::encode_interleaved(std::span<const uint8_t> data, const std::array<Code, 256>& codes,
+BitWriter& writer, const std::vector<uint64_t>& bits){
+    std::vector<uint8_t> lengths;
+    Container::write_lane_lengths(lengths, bits);
+    writer.put_bytes(lengths.data(), lengths.size());
+
+    const size_t streams = bits.size();
+    for(size_t lane = 0; lane < streams; ++lane){
+        const uint64_t start_bits = writer.bit_count();
+        for(size_t i = lane; i < data.size(); i += streams){
+            const Code& code = codes[data[i]];
+            if(code.empty()){
+                LOG.error("Error no such symbol in dictionary: " + std::to_string(data[i]), "Encoder::encode_interleaved");
+                throw std::runtime_error("No such symbol in dictionary");
+            }
+            writer.put(code);
+        }
+        if(writer.bit_count() - start_bits != bits[lane]){
+            LOG.error("Lane " + std::to_string(lane) + " size mismatch", "Encoder::encode_interleaved");
+            throw std::runtime_error("Error in encoding");
+        }
+        const unsigned tail = static_cast<unsigned>(writer.bit_count() % 8);
+        if(tail != 0){
+            writer.put(0, 8 - tail);
+        }
+    }
+}
+
+void Encoder::print_preview(std::span<const uint8_t> data, const std::array<Code, 256>& codes) const{
+    if(!preview_) return;
+    for(unsigned char u_ch : data.first(std::min<size_t>(data.size(), cout_number))){
+        std::cout << codes[u_ch].to_string();
+    }
+}
+
+void Encoder::block_encode(){
+    OutputFile output(output_path_text_);
+    std::ostream& output_text = output.stream();
+
+    const auto data = input_.bytes();
+    const size_t block_count = (data.size() + block_size_ - 1) / block_size_;
+    if(block_count > std::numeric_limits<uint32_t>::max()){
+        LOG.error("Too many blocks: " + std::to_string(block_count), "Encoder::block_encode");
+        throw std::runtime_error("Too many blocks");
+    }
+    auto block_data = [&](size_t i){
+        return data.subspan(i * block_size_, std::min(block_size_, data.size() - i * block_size_));
+    };
+
+    // Only the serialized table is kept between the passes, a few hundred bytes
+    // per block, so the number of blocks and not their size bounds memory
+    struct Block{
+        std::vector<uint8_t> codes;
+        uint64_t bit_count = 0;
+        std::vector<uint64_t> lanes;    // bits per lane of an interleaved block
+    };
+    std::vector<Block> blocks(block_count);
+    std::deque<std::future<Histogram::Counts>> tables;
+    std::deque<std::future<std::vector<uint8_t>>> in_flight;
+
+    // Payload of a block followed by its sync index
+    auto body_size = [&](size_t i){
+        if(streams_ > 1){
+            return Container::interleaved_size(blocks[i].lanes);
+        }
+        const uint64_t index = sync_interval_ != 0 ? Container::index_size(block_data(i).size(), sync_interval_) : 0;
+        return (blocks[i].bit_count + 7) / 8 + index;
+    };
+
+    auto block_codes = [&](size_t i){
+        std::array<Code, 256> codes;
+        Container::read_codes(blocks[i].codes.data(), blocks[i].codes.size(), codes);
+        return codes;
+    };
+
+    // Declared after everything the tasks use, so that its destructor waits for them
+    // before any of it goes away, also when writing a block throws
+    ThreadPool pool(threads_);
+    const size_t window = 2 * static_cast<size_t>(pool.size());
+
+    // Pass 1: histogram and code table of every block, they give exact sizes for the directory
+    PhaseTimer tables_timer(metrics_, "tables");
+    Histogram::Counts total_counts{};
+    auto add_next = [&](){
+        const Histogram::Counts counts = tables.front().get();
+        tables.pop_front();
+        for(size_t s = 0; s < total_counts.size(); ++s){
+            total_counts[s] += counts[s];
+        }
+    };
+    for(size_t i = 0; i < block_count; ++i){
+        tables.push_back(pool.submit([&, i]() {
+            const Histogram::Counts counts = Histogram::count_serial(block_data(i));
+            const FanoTable table(counts, max_code_length_);
+            Container::write_codes(blocks[i].codes, table.codes());
+            blocks[i].bit_count = table.encoded_bits(counts);
+            if(streams_ > 1){
+                blocks[i].lanes = lane_bits(block_data(i), table.codes(), streams_);
+            }
+            return counts;
+        }));
+        if(tables.size() >= window){
+            add_next();
+        }
+    }
+    while(!tables.empty()){
+        add_next();
+    }
+    tables_timer.stop();
+
+    for(const Block& block : blocks){
+        metrics_.payload_bits += block.bit_count;
+    }
+    metrics_.entropy = Metrics::entropy_of(total_counts);
+
+    PhaseTimer encode_timer(metrics_, "encode");
+
+    Container::Header header;
+    header.engine = Container::Engine::Fano;
+    header.flags = Container::BLOCKED | (sync_interval_ != 0 ? Container::SYNC_INDEX : 0);
+    header.flags |= streams_ > 1 ? Container::INTERLEAVED : 0;
+    header.max_code_length = static_cast<uint8_t>(max_code_length_);
+    header.original_size = data.size();
+    header.block_size = block_size_;
+    header.block_count = static_cast<uint32_t>(block_count);
+    header.lanes = static_cast<uint8_t>(streams_);
+
+    std::vector<Container::BlockEntry> entries(block_count);
+    uint64_t offset = Container::HEADER_SIZE + block_count * Container::ENTRY_SIZE;
+    for(size_t i = 0; i < block_count; ++i){
+        entries[i] = {offset, block_data(i).size(), blocks[i].bit_count};
+        offset += blocks[i].codes.size() + body_size(i);
+    }
+
+    std::vector<uint8_t> head;
+    Container::write_header(head, header);
+    Container::write_directory(head, entries);
+    output_text.write(reinterpret_cast<const char*>(head.data()), static_cast<std::streamsize>(head.size()));
+
+    if(block_count != 0 && !output.is_stdout()){
+        print_preview(block_data(0), block_codes(0));
+    }
+
+    // Pass 2: encode blocks concurrently, write them in order with a bounded number in flight
+    size_t next_to_write = 0;
+    auto write_next = [&](){
+        const std::vector<uint8_t> payload = in_flight.front().get();
+        in_flight.pop_front();
+        const Block& block = blocks[next_to_write];
+        if(payload.size() != body_size(next_to_write)){
+            LOG.error("Block " + std::to_string(next_to_write) + " size mismatch", "Encoder::block_encode");
+            throw std::runtime_error("Error in encoding");
+        }
+        output_text.write(reinterpret_cast<const char*>(block.codes.data()), static_cast<std::streamsize>(block.codes.size()));
+        output_text.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+        if(!output_text){
+            LOG.error("Error in writing file " + output_path_text_, "Encoder::block_encode");
+            throw std::runtime_error("Error in writing file");
+        }
+        ++next_to_write;
+    };
+
+    for(size_t i = 0; i < block_count; ++i){
+        in_flight.push_back(pool.submit([&, i]() {
+            std::vector<uint8_t> payload;
+            payload.reserve(static_cast<size_t>((blocks[i].bit_count + 7) / 8));
+            SyncIndex index;
+            BitWriter writer(payload, size_t{1} << 16);
+            if(streams_ > 1){
+                encode_interleaved(block_data(i), block_codes(i), writer, blocks[i].lanes);
+            }
+            else{
+                encode_span(block_data(i), block_codes(i), writer, sync_interval_, index);
+            }
+            writer.finish();
+            if(sync_interval_ != 0){
+                Container::write_index(payload, index);
+            }
+            return payload;
+        }));
+        if(in_flight.size() >= window){
+            write_next();
+        }
+    }
+    while(!in_flight.empty()){
+        write_next();
+    }
+    output.flush();
+    encode_timer.stop();
+    metrics_.bytes_out = offset;
+
+    LOG.info("Blocked encoding completed. Blocks: " + std::to_string(block_count) +
+             ", bytes: " + std::to_string(offset), "Encoder::block_encode");
+}
+
+bool Encoder::can_pipeline() const{
+    if(!Pipeline::supported() || input_path_ == MappedFile::STDIN_PATH || OutputFile::is_stdout_path(output_path_text_)){
+        LOG.info("Pipeline needs positional input and output files, encoding as usual", "Encoder::can_pipeline");
+        return false;
+    }
+    return true;
+}
+
+uint64_t Encoder::encode_block(std::span<const uint8_t> data, std::vector<uint8_t>& out, Histogram::Counts& counts) const{
+    counts = Histogram::count_serial(data);
+    const FanoTable table(counts, max_code_length_);
+    const uint64_t bit_count = table.encoded_bits(counts);
+    Container::write_codes(out, table.codes());
+
+    SyncIndex index;
+    BitWriter writer(out, size_t{1} << 16);
+    if(streams_ > 1){
+        encode_interleaved(data, table.codes(), writer, lane_bits(data, table.codes(), streams_));
+    }
+    else{
+        encode_span(data, table.codes(), writer, sync_interval_, index);
+    }
+    writer.finish();
+    if(sync_interval_ != 0){
+        Container::write_index(out, index);
+    }
+    return bit_count;
+}
+
+void Encoder::pipeline_encode(){
+    const uint64_t size = input_.size();
+    const uint64_t block_count = (size + block_size_ - 1) / block_size_;
+    if(block_count > std::numeric_limits<uint32_t>::max()){
+        LOG.error("Too many blocks: " + std::to_string(block_count), "Encoder::pipeline_encode");
+        throw std::runtime_error("Too many blocks");
+    }
+
+    Container::Header header;
+    header.engine = Container::Engine::Fano;
+    header.flags = Container::BLOCKED | (sync_interval_ != 0 ? Container::SYNC_INDEX : 0);
+    header.flags |= streams_ > 1 ? Container::INTERLEAVED : 0;
+    header.max_code_length = static_cast<uint8_t>(max_code_length_);
+    header.original_size = size;
+    header.block_size = block_size_;
+    header.block_count = static_cast<uint32_t>(block_count);
+    header.lanes = static_cast<uint8_t>(streams_);
+
+    std::vector<Pipeline::Range> ranges(static_cast<size_t>(block_count));
+    for(size_t i = 0; i < ranges.size(); ++i){
+        ranges[i] = {i * block_size_, static_cast<size_t>(std::min<uint64_t>(block_size_, size - i * block_size_))};
+    }
+
+    // Blocks are coded in order, so each one starts where the previous ended.
+    // Header and directory go in front once all sizes are known
+    PhaseTimer encode_timer(metrics_, "encode");
+    std::vector<Container::BlockEntry> entries(ranges.size());
+    Histogram::Counts total_counts{};
+    uint64_t offset = Container::HEADER_SIZE + block_count * Container::ENTRY_SIZE;
+    Pipeline pipeline(input_path_, output_path_text_, 0, pipeline_io_);
+    pipeline.run(ranges, [&](const Pipeline::Buffer& in, Pipeline::Buffer& out) {
+        Histogram::Counts counts{};
+        const uint64_t bit_count = encode_block(in.data, out.data, counts);
+        for(size_t s = 0; s < total_counts.size(); ++s){
+            total_counts[s] += counts[s];
+        }
+        if(in.index == 0){
+            std::array<Code, 256> codes;
+            Container::read_codes(out.data.data(), out.data.size(), codes);
+            print_preview(in.data, codes);
+        }
+        entries[in.index] = {offset, in.data.size(), bit_count};
+        out.offset = offset;
+        offset += out.data.size();
+        metrics_.payload_bits += bit_count;
+    });
+
+    std::vector<uint8_t> head;
+    Container::write_header(head, header);
+    Container::write_directory(head, entries);
+    pipeline.write_at(0, head.data(), head.size());
+    pipeline.close();
+    encode_timer.stop();
+
+    metrics_.entropy = Metrics::entropy_of(total_counts);
+    metrics_.add_phase("read_io", pipeline.read_seconds());
+    metrics_.add_phase("write_io", pipeline.write_seconds());
+    metrics_.add_phase("stall", pipeline.stall_seconds());
+    metrics_.bytes_out = offset;
+
+    LOG.info("Pipelined encoding completed. Blocks: " + std::to_string(block_count) + ", bytes: " +
+             std::to_string(offset) + ", I/O " + Pipeline::name(pipeline.io()), "Encoder::pipeline_encode");
 }
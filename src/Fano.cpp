@@ -0,0 +1,511 @@
+#include "Fano.hpp"
+#include "BitReader.hpp"
+#include "BitWriter.hpp"
+#include "Container.hpp"
+#include "DecodeTable.hpp"
+#include "Encoder.hpp"
+#include "FanoTable.hpp"
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include "SyncIndex.hpp"
+#include "ThreadPool.hpp"
+#include "UniEncoder.hpp"
+#include "UniformKernels.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#define LOG Logger::getInstance()
+
+namespace fano{
+
+namespace{
+
+std::span<const uint8_t> as_bytes(std::span<const std::byte> data){
+    return {reinterpret_cast<const uint8_t*>(data.data()), data.size()};
+}
+
+Container::Engine container_engine(Engine engine){
+    return engine == Engine::Uniform ? Container::Engine::Uniform : Container::Engine::Fano;
+}
+
+// Fixed length codes in symbol order, as UniEncoder assigns them
+std::array<Code, 256> uniform_codes(const Histogram::Counts& counts){
+    unsigned total = 0;
+    for(uint64_t count : counts){
+        if(count != 0) ++total;
+    }
+    const unsigned length = std::max<unsigned>(1u, std::bit_width(total - 1));
+    std::array<Code, 256> codes{};
+    unsigned index = 0;
+    for(size_t i = 0; i < counts.size(); ++i){
+        if(counts[i] == 0) continue;
+        codes[i].bits = index++;
+        codes[i].length = static_cast<uint8_t>(length);
+    }
+    return codes;
+}
+
+CodeTable table_for(const Histogram::Counts& counts, Engine engine, unsigned max_code_length){
+    if(engine == Engine::Uniform){
+        return CodeTable(engine, uniform_codes(counts));
+    }
+    return CodeTable(engine, FanoTable(counts, max_code_length).codes());
+}
+
+uint64_t bits_for(const Histogram::Counts& counts, const CodeTable& table){
+    uint64_t bits = 0;
+    for(size_t i = 0; i < counts.size(); ++i){
+        if(counts[i] == 0) continue;
+        if(table.codes()[i].empty()){
+            LOG.error("No code for symbol " + std::to_string(i), "fano::CodeTable");
+            throw std::runtime_error("Code table does not cover the input");
+        }
+        bits += counts[i] * table.codes()[i].length;
+    }
+    return bits;
+}
+
+// Block of the container being written: its table and exact sizes
+struct Block{
+    std::span<const uint8_t> data;
+    CodeTable table;
+    std::vector<uint8_t> codes;
+    uint64_t bit_count = 0;
+    std::vector<uint64_t> lanes;    // bits per lane when interleaved
+};
+
+struct Plan{
+    Container::Header header;
+    std::vector<Block> blocks;
+    std::vector<Container::BlockEntry> entries;
+    uint64_t interval = 0;
+    uint64_t size = 0;
+};
+
+void check_options(const EncodeOptions& options){
+    if(options.engine == Engine::Uniform && options.sync_interval != 0){
+        LOG.error("Sync index is only supported by the Fano engine", "fano::encode");
+        throw std::runtime_error("Sync index is only supported by the Fano engine");
+    }
+    if(options.engine == Engine::Uniform && options.max_code_length != 0){
+        LOG.error("Code length limit is only supported by the Fano engine", "fano::encode");
+        throw std::runtime_error("Code length limit is only supported by the Fano engine");
+    }
+    if(options.streams != 1){
+        if(!Container::valid_lanes(options.streams)){
+            LOG.error("Invalid stream count " + std::to_string(options.streams), "fano::encode");
+            throw std::runtime_error("Stream count must be 1, 2, 4 or 8");
+        }
+        if(options.engine == Engine::Uniform || options.sync_interval != 0){
+            LOG.error("Interleaved streams need the Fano engine and no sync index", "fano::encode");
+            throw std::runtime_error("Interleaved streams need the Fano engine and no sync index");
+        }
+    }
+}
+
+// Tables are known before any payload bit, so the directory is exact
+void finish_plan(Plan& plan){
+    std::vector<uint8_t> head;
+    uint64_t offset = Container::HEADER_SIZE + plan.blocks.size() * Container::ENTRY_SIZE;
+    for(Block& block : plan.blocks){
+        Container::write_codes(block.codes, block.table.codes());
+        plan.entries.push_back({offset, block.data.size(), block.bit_count});
+        offset += block.codes.size();
+        offset += block.lanes.empty() ? (block.bit_count + 7) / 8 : Container::interleaved_size(block.lanes);
+        if(plan.interval != 0){
+            offset += Container::index_size(block.data.size(), plan.interval);
+        }
+    }
+    plan.size = offset;
+}
+
+Plan make_plan(std::span<const uint8_t> data, const EncodeOptions& options){
+    check_options(options);
+    Plan plan;
+    plan.interval = options.sync_interval;
+
+    const size_t block_size = options.block_size != 0 ? options.block_size : std::max<size_t>(data.size(), 1);
+    const size_t block_count = (data.size() + block_size - 1) / block_size;
+    if(block_count > std::numeric_limits<uint32_t>::max()){
+        LOG.error("Too many blocks: " + std::to_string(block_count), "fano::encode");
+        throw std::runtime_error("Too many blocks");
+    }
+
+    plan.header.engine = container_engine(options.engine);
+    plan.header.flags = (options.block_size != 0 ? Container::BLOCKED : 0) |
+                        (options.sync_interval != 0 ? Container::SYNC_INDEX : 0) |
+                        (options.streams > 1 ? Container::INTERLEAVED : 0);
+    plan.header.lanes = static_cast<uint8_t>(options.streams);
+    plan.header.max_code_length = static_cast<uint8_t>(options.max_code_length);
+    plan.header.original_size = data.size();
+    plan.header.block_size = options.block_size != 0 ? options.block_size : data.size();
+    plan.header.block_count = static_cast<uint32_t>(block_count);
+
+    plan.blocks.resize(block_count);
+    auto build = [&](size_t i){
+        Block& block = plan.blocks[i];
+        block.data = data.subspan(i * block_size, std::min(block_size, data.size() - i * block_size));
+        const Histogram::Counts counts = Histogram::count_serial(block.data);
+        block.table = table_for(counts, options.engine, options.max_code_length);
+        block.bit_count = bits_for(counts, block.table);
+        if(options.streams > 1){
+            block.lanes = Encoder::lane_bits(block.data, block.table.codes(), options.streams);
+        }
+    };
+
+    if(block_count > 1 && options.threads != 1){
+        ThreadPool pool(options.threads);
+        std::vector<std::future<void>> tables;
+        for(size_t i = 0; i < block_count; ++i){
+            tables.push_back(pool.submit([&, i]() { build(i); }));
+        }
+        for(auto& table : tables){
+            table.get();
+        }
+    }
+    else{
+        for(size_t i = 0; i < block_count; ++i){
+            build(i);
+        }
+    }
+
+    finish_plan(plan);
+    return plan;
+}
+
+// Payload and index of a block, exactly the size the directory promises
+std::vector<uint8_t> encode_block(const Block& block, uint64_t interval){
+    std::vector<uint8_t> payload;
+    payload.reserve(static_cast<size_t>((block.bit_count + 7) / 8));
+    SyncIndex index;
+    BitWriter writer(payload, size_t{1} << 16);
+    if(!block.lanes.empty()){
+        Encoder::encode_interleaved(block.data, block.table.codes(), writer, block.lanes);
+    }
+    else if(block.table.engine() == Engine::Uniform && interval == 0){
+        UniEncoder::encode_span(block.data, block.table.codes(), writer);
+    }
+    else{
+        Encoder::encode_span(block.data, block.table.codes(), writer, interval, index);
+    }
+    writer.finish();
+    if(interval != 0){
+        Container::write_index(payload, index);
+    }
+    return payload;
+}
+
+size_t write_plan(const Plan& plan, std::span<std::byte> out, unsigned threads){
+    if(out.size() < plan.size){
+        LOG.error("Output buffer of " + std::to_string(out.size()) + " bytes is smaller than " +
+                  std::to_string(plan.size), "fano::encode");
+        throw std::runtime_error("Output buffer is too small");
+    }
+    uint8_t* dest = reinterpret_cast<uint8_t*>(out.data());
+
+    std::vector<uint8_t> head;
+    Container::write_header(head, plan.header);
+    Container::write_directory(head, plan.entries);
+    std::memcpy(dest, head.data(), head.size());
+
+    auto write_block = [&](size_t i){
+        const Block& block = plan.blocks[i];
+        const std::vector<uint8_t> payload = encode_block(block, plan.interval);
+        uint8_t* at = dest + plan.entries[i].offset;
+        std::memcpy(at, block.codes.data(), block.codes.size());
+        std::memcpy(at + block.codes.size(), payload.data(), payload.size());
+    };
+
+    if(plan.blocks.size() > 1 && threads != 1){
+        ThreadPool pool(threads);
+        std::vector<std::future<void>> blocks;
+        for(size_t i = 0; i < plan.blocks.size(); ++i){
+            blocks.push_back(pool.submit([&, i]() { write_block(i); }));
+        }
+        for(auto& block : blocks){
+            block.get();
+        }
+    }
+    else{
+        for(size_t i = 0; i < plan.blocks.size(); ++i){
+            write_block(i);
+        }
+    }
+    return static_cast<size_t>(plan.size);
+}
+
+// Code table, payload and bounds of a container block
+struct Stream{
+    const uint8_t* payload = nullptr;
+    size_t bytes = 0;
+    uint64_t bit_count = 0;
+    uint64_t raw_size = 0;
+    uint64_t output_offset = 0;
+    unsigned max_code_length = 0;
+    bool uniform = false;
+    std::array<Code, 256> codes{};
+    std::vector<Container::Lane> lanes;
+};
+
+std::vector<Stream> read_streams(std::span<const uint8_t> data, Container::Header& header){
+    header = Container::read_header(data.data(), data.size());
+    std::vector<Stream> streams;
+    uint64_t output_offset = 0;
+    for(const auto& entry : Container::read_directory(data.data(), data.size(), header)){
+        Stream stream;
+        const size_t table_size = Container::read_codes(data.data() + entry.offset, data.size() - entry.offset,
+                                                        stream.codes, header.max_code_length);
+        const uint64_t payload_offset = entry.offset + table_size;
+        uint64_t payload_bytes = (entry.bit_count + 7) / 8;
+        if(header.flags & Container::INTERLEAVED && payload_offset <= data.size()){
+            stream.lanes = Container::read_lanes(data.data() + payload_offset,
+                                                 data.size() - static_cast<size_t>(payload_offset), entry, header.lanes);
+            payload_bytes = Container::lanes_size(stream.lanes);
+        }
+        if(payload_offset > data.size() || payload_bytes > data.size() - payload_offset){
+            LOG.error("Block is out of container bounds", "fano::decode");
+            throw std::runtime_error("Corrupted container: invalid block");
+        }
+        // Every code is at least one bit, so the payload bounds the decoded size
+        if(entry.raw_size > entry.bit_count){
+            LOG.error("Block of " + std::to_string(entry.bit_count) + " bits holds " +
+                      std::to_string(entry.raw_size) + " symbols", "fano::decode");
+            throw std::runtime_error("Corrupted container: invalid block");
+        }
+        stream.payload = data.data() + payload_offset;
+        stream.bytes = static_cast<size_t>(payload_bytes);
+        stream.bit_count = entry.bit_count;
+        stream.raw_size = entry.raw_size;
+        stream.output_offset = output_offset;
+        stream.max_code_length = header.max_code_length;
+        stream.uniform = header.engine == Container::Engine::Uniform;
+        output_offset += entry.raw_size;
+        streams.push_back(std::move(stream));
+    }
+    if(output_offset != header.original_size){
+        LOG.error("Blocks hold " + std::to_string(output_offset) + " bytes instead of " +
+                  std::to_string(header.original_size), "fano::decode");
+        throw std::runtime_error("Corrupted container: block sizes do not add up");
+    }
+    return streams;
+}
+
+// Codes of one width up to 8 bits are unpacked by the kernels in cache sized pieces,
+// false for other tables and for payloads that are not a whole number of codes
+bool decode_uniform(const Stream& stream, uint8_t* out){
+    UniformKernels::ByteMap symbols;
+    unsigned width = 0;
+    for(size_t symbol = 0; symbol < stream.codes.size(); ++symbol){
+        const Code& code = stream.codes[symbol];
+        if(code.empty()){
+            continue;
+        }
+        if((width != 0 && width != code.length) || code.length > UniformKernels::MAX_WIDTH){
+            return false;
+        }
+        width = code.length;
+        symbols.value[static_cast<size_t>(code.bits)] = static_cast<uint8_t>(symbol);
+        symbols.valid[static_cast<size_t>(code.bits)] = true;
+    }
+    if(width == 0 || stream.bit_count % width != 0 || stream.bit_count / width != stream.raw_size){
+        return false;
+    }
+
+    const UniformKernels::Kernels kernels = UniformKernels::for_width(width);
+    const size_t count = static_cast<size_t>(stream.raw_size);
+    for(size_t done = 0; done < count; done += UniEncoder::CHUNK_SIZE){
+        const size_t n = std::min(UniEncoder::CHUNK_SIZE, count - done);
+        kernels.unpack(stream.payload + done / 8 * width, n, out + done);
+        if(UniformKernels::map(out + done, n, symbols, out + done) != n){
+            LOG.error("Code is not in dictionary", "fano::decode");
+            throw std::runtime_error("Corrupted container: code is not in dictionary");
+        }
+    }
+    return true;
+}
+
+void decode_stream(const Stream& stream, uint8_t* out){
+    if(stream.uniform && decode_uniform(stream, out)){
+        return;
+    }
+    const DecodeTable table(stream.codes, DecodeTable::root_bits(stream.max_code_length));
+    if(!stream.lanes.empty()){
+        std::vector<BitReader> readers;
+        for(const Container::Lane& lane : stream.lanes){
+            readers.emplace_back(stream.payload + lane.offset, static_cast<size_t>((lane.bit_count + 7) / 8),
+                                 lane.bit_count);
+        }
+        table.decode_interleaved(readers.data(), static_cast<unsigned>(readers.size()), out,
+                                 static_cast<size_t>(stream.raw_size));
+        for(const BitReader& reader : readers){
+            if(reader.bits_left() != 0){
+                LOG.error("Lane has bits left after " + std::to_string(stream.raw_size) + " symbols", "fano::decode");
+                throw std::runtime_error("Corrupted container: payload does not match the block size");
+            }
+        }
+        return;
+    }
+    BitReader reader(stream.payload, stream.bytes, stream.bit_count);
+    const size_t decoded = table.decode(reader, out, static_cast<size_t>(stream.raw_size));
+    if(decoded != stream.raw_size || reader.bits_left() != 0){
+        LOG.error("Block decoded to " + std::to_string(decoded) + " symbols instead of " +
+                  std::to_string(stream.raw_size), "fano::decode");
+        throw std::runtime_error("Corrupted container: payload does not match the block size");
+    }
+}
+
+// Blocks into dest at their output offsets, on a pool when there are several
+void decode_streams(const std::vector<Stream>& streams, uint8_t* dest, unsigned threads){
+    if(streams.size() > 1 && threads != 1){
+        ThreadPool pool(threads);
+        std::vector<std::future<void>> parts;
+        for(const Stream& stream : streams){
+            parts.push_back(pool.submit([&stream, dest]() { decode_stream(stream, dest + stream.output_offset); }));
+        }
+        for(auto& part : parts){
+            part.get();
+        }
+    }
+    else{
+        for(const Stream& stream : streams){
+            decode_stream(stream, dest + stream.output_offset);
+        }
+    }
+}
+
+}
+
+CodeTable CodeTable::build(std::span<const std::byte> data, Engine engine, unsigned max_code_length){
+    EncodeOptions options;
+    options.engine = engine;
+    options.max_code_length = max_code_length;
+    check_options(options);
+    return table_for(Histogram::count_serial(as_bytes(data)), engine, max_code_length);
+}
+
+size_t CodeTable::size() const{
+    return static_cast<size_t>(std::count_if(codes_.begin(), codes_.end(), [](const Code& code){
+        return !code.empty();
+    }));
+}
+
+uint64_t CodeTable::encoded_bits(std::span<const std::byte> data) const{
+    return bits_for(Histogram::count_serial(as_bytes(data)), *this);
+}
+
+std::vector<std::byte> CodeTable::serialize() const{
+    std::vector<uint8_t> out;
+    Container::write_codes(out, codes_);
+    const auto* begin = reinterpret_cast<const std::byte*>(out.data());
+    return {begin, begin + out.size()};
+}
+
+CodeTable CodeTable::deserialize(std::span<const std::byte> data, Engine engine, size_t* used){
+    std::array<Code, 256> codes;
+    const auto bytes = as_bytes(data);
+    const size_t size = Container::read_codes(bytes.data(), bytes.size(), codes);
+    if(used){
+        *used = size;
+    }
+    return CodeTable(engine, codes);
+}
+
+bool operator==(const CodeTable& a, const CodeTable& b){
+    if(a.engine_ != b.engine_) return false;
+    for(size_t i = 0; i < a.codes_.size(); ++i){
+        if(a.codes_[i].length != b.codes_[i].length || a.codes_[i].bits != b.codes_[i].bits){
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::byte> encode(std::span<const std::byte> data, const EncodeOptions& options){
+    const Plan plan = make_plan(as_bytes(data), options);
+    std::vector<std::byte> out(static_cast<size_t>(plan.size));
+    write_plan(plan, out, options.threads);
+    return out;
+}
+
+std::vector<std::byte> encode(std::span<const std::byte> data, const CodeTable& table, uint64_t sync_interval){
+    EncodeOptions options;
+    options.engine = table.engine();
+    options.sync_interval = sync_interval;
+    check_options(options);
+
+    const auto bytes = as_bytes(data);
+    Plan plan;
+    plan.interval = sync_interval;
+    plan.header.engine = container_engine(table.engine());
+    plan.header.flags = sync_interval != 0 ? Container::SYNC_INDEX : 0;
+    plan.header.original_size = bytes.size();
+    plan.header.block_size = bytes.size();
+    plan.header.block_count = bytes.empty() ? 0 : 1;
+    if(!bytes.empty()){
+        Block block;
+        block.data = bytes;
+        block.table = table;
+        block.bit_count = bits_for(Histogram::count_serial(bytes), table);
+        plan.blocks.push_back(std::move(block));
+    }
+    finish_plan(plan);
+
+    std::vector<std::byte> out(static_cast<size_t>(plan.size));
+    write_plan(plan, out, 1);
+    return out;
+}
+
+size_t encode(std::span<const std::byte> data, std::span<std::byte> out, const EncodeOptions& options){
+    return write_plan(make_plan(as_bytes(data), options), out, options.threads);
+}
+
+size_t max_encoded_size(size_t size, const EncodeOptions& options){
+    const size_t block_size = options.block_size != 0 ? options.block_size : std::max<size_t>(size, 1);
+    const size_t block_count = (size + block_size - 1) / block_size;
+    // Code table of every byte value with the longest code
+    const size_t max_bits = options.engine == Engine::Uniform ? 8 :
+                            options.max_code_length != 0 ? options.max_code_length : Code::MAX_LENGTH;
+    const size_t table = 2 + 2 * 256 + 256 * max_bits / 8;
+    size_t total = Container::HEADER_SIZE + block_count * (Container::ENTRY_SIZE + table) + size * max_bits / 8;
+    if(options.sync_interval != 0){
+        total += block_count * 16 + 16 * ((size + options.sync_interval - 1) / options.sync_interval + block_count);
+    }
+    if(options.streams > 1){
+        // Length and padding byte of every lane
+        total += block_count * 9 * options.streams;
+    }
+    return total;
+}
+
+uint64_t decoded_size(std::span<const std::byte> container){
+    const auto bytes = as_bytes(container);
+    return Container::read_header(bytes.data(), bytes.size()).original_size;
+}
+
+std::vector<std::byte> decode(std::span<const std::byte> container, unsigned threads){
+    // Sized only after the directory and the blocks are checked against the container
+    Container::Header header;
+    const std::vector<Stream> streams = read_streams(as_bytes(container), header);
+    std::vector<std::byte> out(static_cast<size_t>(header.original_size));
+    decode_streams(streams, reinterpret_cast<uint8_t*>(out.data()), threads);
+    return out;
+}
+
+size_t decode(std::span<const std::byte> container, std::span<std::byte> out, unsigned threads){
+    Container::Header header;
+    const std::vector<Stream> streams = read_streams(as_bytes(container), header);
+    if(out.size() < header.original_size){
+        LOG.error("Output buffer of " + std::to_string(out.size()) + " bytes is smaller than " +
+                  std::to_string(header.original_size), "fano::decode");
+        throw std::runtime_error("Output buffer is too small");
+    }
+    decode_streams(streams, reinterpret_cast<uint8_t*>(out.data()), threads);
+    return static_cast<size_t>(header.original_size);
+}
+
+}
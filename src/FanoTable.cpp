@@ -0,0 +1,179 @@
+#include "FanoTable.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#define LOG Logger::getInstance()
+
+void FanoTable::build(const Counts& counts, unsigned max_length){
+    dict_ = {};
+    count_vec_.clear();
+    max_length_ = max_length;
+    if (max_length_ > MAX_LENGTH_LIMIT) {
+        LOG.error("Code length limit " + std::to_string(max_length_) + " is above " +
+                  std::to_string(MAX_LENGTH_LIMIT), "FanoTable::build");
+        throw std::runtime_error("Code length limit is too large");
+    }
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] != 0) {
+            count_vec_.push_back({static_cast<unsigned char>(i), counts[i]});
+        }
+    }
+    if (count_vec_.empty()) {
+        return;
+    }
+
+    if (max_length_ != 0 && max_length_ < 9 && count_vec_.size() > (size_t{1} << max_length_)) {
+        LOG.error(std::to_string(count_vec_.size()) + " symbols do not fit into codes of " +
+                  std::to_string(max_length_) + " bits", "FanoTable::build");
+        throw std::runtime_error("Code length limit is too small for the alphabet");
+    }
+
+    if (count_vec_.size() == 1) {
+        dict_[count_vec_[0].first] = Code{1, 1};
+        return;
+    }
+
+    std::sort(count_vec_.begin(), count_vec_.end(), [](auto &a, auto &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+
+    // Sums of a range never exceed the input size, so they fit into 64 bits
+    prefix_.assign(count_vec_.size() + 1, 0);
+    for (size_t i = 0; i < count_vec_.size(); ++i) {
+        prefix_[i + 1] = prefix_[i] + count_vec_[i].second;
+    }
+    fill_dict(0, count_vec_.size() - 1);
+    if (max_length_ != 0) {
+        limit_lengths();
+    }
+}
+
+uint64_t FanoTable::encoded_bits(const Counts& counts) const{
+    uint64_t bits = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        bits += counts[i] * dict_[i].length;
+    }
+    return bits;
+}
+
+void FanoTable::fill_dict(size_t beg, size_t end){
+    if(end > beg){
+        auto med = find_med(beg, end);
+        for(size_t i = beg; i <= end; ++i){
+            Code& code = dict_[count_vec_[i].first];
+            if(code.length == Code::MAX_LENGTH){
+                LOG.error("Code is longer than " + std::to_string(Code::MAX_LENGTH) + " bits",
+                          "FanoTable::fill_dict");
+                throw std::runtime_error("Code is too long");
+            }
+            code.push_back(i >= med);
+        }
+        fill_dict(beg, med - 1);
+        fill_dict(med, end);
+    }
+}
+
+size_t FanoTable::find_med(size_t beg, size_t end) const {
+    if (beg == end) {
+        return beg;
+    }
+
+    // The left half [beg, med) grows with med, so the first med where it holds
+    // at least half of the range is the balance point or the one right after it
+    const uint64_t base = prefix_[beg];
+    const uint64_t total = prefix_[end + 1] - base;
+    auto first = prefix_.begin() + static_cast<std::ptrdiff_t>(beg + 1);
+    auto last = prefix_.begin() + static_cast<std::ptrdiff_t>(end);
+    size_t med = static_cast<size_t>(std::lower_bound(first, last, base + total - total / 2) - prefix_.begin());
+
+    // On equal differences the shorter left half wins
+    if (med > beg + 1) {
+        const uint64_t below = prefix_[med - 1] - base;
+        const uint64_t above = prefix_[med] - base;
+        if (total - 2 * below <= 2 * above - total) {
+            --med;
+        }
+    }
+
+    LOG_DEBUG("Found median: {} for range [{}-{}]", "FanoTable::find_med", med, beg, end);
+
+    return med;
+}
+
+void FanoTable::limit_lengths() {
+    const unsigned limit = max_length_;
+    const size_t n = count_vec_.size();
+    bool cut = false;
+    for (const auto& [symbol, count] : count_vec_) {
+        cut = cut || dict_[symbol].length > limit;
+    }
+    if (!cut) {
+        return;
+    }
+
+    // Package-merge: a code of length l is made of l coins, one of every width
+    // 2^-1..2^-l, and the 2n - 2 cheapest coins of all widths give the shortest
+    // code within the limit. levels[0] holds the narrowest coins, every next
+    // level its pairs merged with the symbols again. A weight sums at most
+    // `limit` coins per symbol, so it fits while the input is below 2^59 bytes
+    struct Item {
+        uint64_t weight;
+        size_t symbol;  // index in count_vec_, n for a pair
+        size_t first;   // pair of items first, first + 1 of the previous level
+    };
+    std::vector<Item> leaves;
+    for (size_t i = n; i-- > 0;) {
+        leaves.push_back({count_vec_[i].second, i, 0});
+    }
+    std::vector<std::vector<Item>> levels(limit);
+    levels[0] = leaves;
+    for (unsigned level = 1; level < limit; ++level) {
+        const std::vector<Item>& previous = levels[level - 1];
+        std::vector<Item>& items = levels[level];
+        size_t leaf = 0;
+        for (size_t pair = 0; pair + 1 < previous.size(); pair += 2) {
+            const uint64_t weight = previous[pair].weight + previous[pair + 1].weight;
+            while (leaf < leaves.size() && leaves[leaf].weight <= weight) {
+                items.push_back(leaves[leaf++]);
+            }
+            items.push_back({weight, n, pair});
+        }
+        items.insert(items.end(), leaves.begin() + static_cast<std::ptrdiff_t>(leaf), leaves.end());
+    }
+
+    // Every coin of a symbol adds a bit to its code
+    std::vector<unsigned> lengths(n, 0);
+    std::vector<std::pair<unsigned, size_t>> pending;
+    for (size_t i = 0; i < 2 * n - 2; ++i) {
+        pending.emplace_back(limit - 1, i);
+    }
+    while (!pending.empty()) {
+        const auto [level, index] = pending.back();
+        pending.pop_back();
+        const Item& item = levels[level][index];
+        if (item.symbol != n) {
+            ++lengths[item.symbol];
+        }
+        else {
+            pending.emplace_back(level - 1, item.first);
+            pending.emplace_back(level - 1, item.first + 1);
+        }
+    }
+
+    // Canonical codes in count order: the shortest codes go to the most
+    // frequent symbols and each length takes the next free prefix
+    std::sort(lengths.begin(), lengths.end());
+    dict_ = {};
+    uint64_t bits = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 0) {
+            bits = (bits + 1) << (lengths[i] - lengths[i - 1]);
+        }
+        dict_[count_vec_[i].first] = Code{bits, static_cast<uint8_t>(lengths[i])};
+    }
+
+    LOG_DEBUG("Codes of {} symbols limited to {} bits", "FanoTable::limit_lengths", n, limit);
+}
@@ -0,0 +1,78 @@
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <future>
+#include <vector>
+
+#define LOG Logger::getInstance()
+
+Histogram::Histogram(unsigned threads)
+    : threads_(threads == 0 ? ThreadPool::hardware_threads() : threads) {}
+
+Histogram::Counts Histogram::count_serial(std::span<const uint8_t> data){
+    // Sub-histogram counters are 32-bit, so long inputs are counted in segments
+    constexpr size_t SEGMENT = size_t{1} << 30;
+    constexpr size_t WAYS = 4;
+
+    Counts counts{};
+    std::vector<uint32_t> sub(WAYS * 256);
+    for(size_t begin = 0; begin < data.size(); begin += SEGMENT){
+        const uint8_t* p = data.data() + begin;
+        const size_t n = std::min(SEGMENT, data.size() - begin);
+        std::fill(sub.begin(), sub.end(), 0u);
+        uint32_t* h0 = sub.data();
+        uint32_t* h1 = h0 + 256;
+        uint32_t* h2 = h1 + 256;
+        uint32_t* h3 = h2 + 256;
+
+        size_t i = 0;
+        for(; i + 8 <= n; i += 8){
+            ++h0[p[i]];
+            ++h1[p[i + 1]];
+            ++h2[p[i + 2]];
+            ++h3[p[i + 3]];
+            ++h0[p[i + 4]];
+            ++h1[p[i + 5]];
+            ++h2[p[i + 6]];
+            ++h3[p[i + 7]];
+        }
+        for(; i < n; ++i){
+            ++h0[p[i]];
+        }
+
+        for(size_t s = 0; s < 256; ++s){
+            counts[s] += static_cast<uint64_t>(h0[s]) + h1[s] + h2[s] + h3[s];
+        }
+    }
+    return counts;
+}
+
+Histogram::Counts Histogram::count(std::span<const uint8_t> data){
+    const size_t chunks = std::min<size_t>(threads_, data.size() / MIN_CHUNK);
+    if(chunks <= 1){
+        return count_serial(data);
+    }
+
+    if(!pool_){
+        pool_ = std::make_unique<ThreadPool>(threads_);
+    }
+
+    // Chunk borders on cache line boundaries
+    const size_t chunk_size = (data.size() / chunks + 63) / 64 * 64;
+    std::vector<std::future<Counts>> parts;
+    for(size_t begin = 0; begin < data.size(); begin += chunk_size){
+        auto chunk = data.subspan(begin, std::min(chunk_size, data.size() - begin));
+        parts.push_back(pool_->submit([chunk]() { return count_serial(chunk); }));
+    }
+
+    Counts counts{};
+    for(auto& part : parts){
+        Counts partial = part.get();
+        for(size_t s = 0; s < counts.size(); ++s){
+            counts[s] += partial[s];
+        }
+    }
+
+    LOG_DEBUG("Histogram counted in {} chunks", "Histogram::count", parts.size());
+    return counts;
+}
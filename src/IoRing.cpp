@@ -0,0 +1,229 @@
+#include "IoRing.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(FANO_IO_URING) && defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define FANO_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define LOG Logger::getInstance()
+
+#ifdef FANO_HAS_IO_URING
+
+namespace{
+
+int ring_setup(unsigned entries, io_uring_params& params){
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int ring_enter(int fd, unsigned submit, unsigned complete, unsigned flags){
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0));
+}
+
+// Ring indices are shared with the kernel
+unsigned load_acquire(unsigned* value){
+    return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire);
+}
+
+void store_release(unsigned* value, unsigned new_value){
+    std::atomic_ref<unsigned>(*value).store(new_value, std::memory_order_release);
+}
+
+}
+
+bool IoRing::supported(){
+    static const bool result = [](){
+        io_uring_params params{};
+        const int fd = ring_setup(2, params);
+        if(fd < 0){
+            return false;
+        }
+        ::close(fd);
+        // IORING_OP_READ and IORING_OP_WRITE came with this feature, in 5.6
+        return (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+    }();
+    return result;
+}
+
+IoRing::IoRing(unsigned entries){
+    io_uring_params params{};
+    fd_ = ring_setup(std::max(entries, 1u), params);
+    if(fd_ < 0){
+        LOG.error("io_uring setup failed, errno " + std::to_string(errno), "IoRing::IoRing");
+        throw std::runtime_error("io_uring is not available");
+    }
+    entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single){
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if(sq_ring_ == MAP_FAILED){
+        sq_ring_ = nullptr;
+        release();
+        LOG.error("io_uring ring mapping failed", "IoRing::IoRing");
+        throw std::runtime_error("io_uring is not available");
+    }
+    if(single){
+        cq_ring_ = sq_ring_;
+    }
+    else{
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if(cq_ring_ == MAP_FAILED){
+            cq_ring_ = nullptr;
+            release();
+            LOG.error("io_uring ring mapping failed", "IoRing::IoRing");
+            throw std::runtime_error("io_uring is not available");
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if(sqes_ == MAP_FAILED){
+        sqes_ = nullptr;
+        release();
+        LOG.error("io_uring entries mapping failed", "IoRing::IoRing");
+        throw std::runtime_error("io_uring is not available");
+    }
+
+    auto* sq = static_cast<uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+}
+
+IoRing::~IoRing(){
+    release();
+}
+
+void IoRing::release(){
+    if(sqes_ != nullptr){
+        ::munmap(sqes_, sqes_size_);
+    }
+    if(cq_ring_ != nullptr && cq_ring_ != sq_ring_){
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if(sq_ring_ != nullptr){
+        ::munmap(sq_ring_, sq_ring_size_);
+    }
+    sqes_ = cq_ring_ = sq_ring_ = nullptr;
+    if(fd_ >= 0){
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void IoRing::queue(uint8_t opcode, int fd, const uint8_t* data, size_t size, uint64_t offset, uint64_t tag){
+    if(pending() >= entries_){
+        LOG.error("More than " + std::to_string(entries_) + " requests in flight", "IoRing::queue");
+        throw std::logic_error("io_uring is full");
+    }
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & *sq_mask_;
+    io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(data);
+    sqe.len = static_cast<uint32_t>(std::min(size, MAX_REQUEST));
+    sqe.off = offset;
+    sqe.user_data = tag;
+    sq_array_[index] = index;
+    store_release(sq_tail_, tail + 1);
+    ++queued_;
+    // Submitted at once, the stage may block on its queues before the next wait()
+    enter(0);
+}
+
+void IoRing::enter(unsigned complete){
+    while(true){
+        const int submitted = ring_enter(fd_, queued_, complete, complete != 0 ? IORING_ENTER_GETEVENTS : 0);
+        if(submitted >= 0){
+            queued_ -= static_cast<unsigned>(submitted);
+            in_flight_ += static_cast<unsigned>(submitted);
+            return;
+        }
+        if(errno != EINTR){
+            LOG.error("io_uring_enter failed, errno " + std::to_string(errno), "IoRing::enter");
+            throw std::runtime_error("io_uring failed");
+        }
+    }
+}
+
+void IoRing::read(int fd, uint8_t* data, size_t size, uint64_t offset, uint64_t tag){
+    queue(IORING_OP_READ, fd, data, size, offset, tag);
+}
+
+void IoRing::write(int fd, const uint8_t* data, size_t size, uint64_t offset, uint64_t tag){
+    queue(IORING_OP_WRITE, fd, data, size, offset, tag);
+}
+
+IoRing::Completion IoRing::wait(){
+    if(pending() == 0){
+        LOG.error("Nothing to wait for", "IoRing::wait");
+        throw std::logic_error("io_uring has no requests");
+    }
+    while(true){
+        const unsigned head = *cq_head_;
+        if(head != load_acquire(cq_tail_)){
+            const io_uring_cqe& cqe = static_cast<const io_uring_cqe*>(cqes_)[head & *cq_mask_];
+            const Completion completion{cqe.user_data, cqe.res};
+            store_release(cq_head_, head + 1);
+            --in_flight_;
+            return completion;
+        }
+        enter(1);
+    }
+}
+
+#else
+
+bool IoRing::supported(){
+    return false;
+}
+
+IoRing::IoRing(unsigned){
+    LOG.error("Built without io_uring", "IoRing::IoRing");
+    throw std::runtime_error("io_uring is not available");
+}
+
+IoRing::~IoRing() = default;
+
+void IoRing::release(){}
+
+void IoRing::enter(unsigned){}
+
+void IoRing::queue(uint8_t, int, const uint8_t*, size_t, uint64_t, uint64_t){
+    throw std::logic_error("io_uring is not available");
+}
+
+void IoRing::read(int, uint8_t*, size_t, uint64_t, uint64_t){
+    throw std::logic_error("io_uring is not available");
+}
+
+void IoRing::write(int, const uint8_t*, size_t, uint64_t, uint64_t){
+    throw std::logic_error("io_uring is not available");
+}
+
+IoRing::Completion IoRing::wait(){
+    throw std::logic_error("io_uring is not available");
+}
+
+#endif
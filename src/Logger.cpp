@@ -1,11 +1,15 @@
 #include "Logger.hpp"
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <ctime>
+#include <vector>
 
 Logger::Logger() = default;
 
 Logger::~Logger() {
+    stopWriter();
     if (logFile_.is_open()) {
         logFile_.close();
     }
@@ -22,10 +26,29 @@ std::string Logger::getCurrentTime() {
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()) % 1000;
 
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %H:%M:%S");
-    ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    return ss.str();
+    // Date and time change once a second, format them only then
+    thread_local std::time_t cachedSecond = -1;
+    thread_local std::string cachedTime;
+    if (in_time_t != cachedSecond) {
+        std::tm tm{};
+#if defined(__unix__) || defined(__APPLE__)
+        localtime_r(&in_time_t, &tm);
+#else
+        tm = *std::localtime(&in_time_t);
+#endif
+        std::stringstream ss;
+        ss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+        cachedTime = ss.str();
+        cachedSecond = in_time_t;
+    }
+
+    const auto millis = static_cast<int>(ms.count());
+    std::string result = cachedTime;
+    result += '.';
+    result += static_cast<char>('0' + millis / 100);
+    result += static_cast<char>('0' + millis / 10 % 10);
+    result += static_cast<char>('0' + millis % 10);
+    return result;
 }
 
 std::string Logger::levelToString(Level level) {
@@ -39,7 +62,7 @@ std::string Logger::levelToString(Level level) {
 }
 
 void Logger::log(Level level, const std::string& message, const std::string& component) {
-    if (level < currentLevel_) {
+    if (!compiled(level) || !enabled(level)) {
         return;
     }
 
@@ -49,8 +72,15 @@ void Logger::log(Level level, const std::string& message, const std::string& com
     }
     logEntry += " " + message;
 
+    if (async_.load(std::memory_order_acquire)) {
+        Record record{level, std::move(logEntry)};
+        push(record);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(sinkMutex_);
     if (logToConsole_) {
-        if (level == Level::ERROR) {
+        if (level == Level::ERROR || logToStderr_) {
             std::cerr << logEntry << std::endl;
         } else {
             std::cout << logEntry << std::endl;
@@ -62,6 +92,108 @@ void Logger::log(Level level, const std::string& message, const std::string& com
     }
 }
 
+void Logger::push(Record& record) {
+    while (!queue_->try_push(record)) {
+        if (policy_ == FullPolicy::Drop) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::this_thread::yield();
+    }
+    pushed_.fetch_add(1, std::memory_order_release);
+    wake_.fetch_add(1, std::memory_order_release);
+    wake_.notify_one();
+}
+
+void Logger::writerLoop() {
+    // Records popped per write, each stream is flushed once per batch
+    constexpr size_t BATCH = 256;
+
+    std::vector<Record> batch(BATCH);
+    std::string out, err, file;
+    while (true) {
+        const uint32_t seen = wake_.load(std::memory_order_acquire);
+
+        size_t count = 0;
+        while (count < BATCH && queue_->try_pop(batch[count])) {
+            ++count;
+        }
+        const uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+
+        if (count == 0 && dropped == 0) {
+            if (stop_.load(std::memory_order_acquire)) {
+                break;
+            }
+            wake_.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        out.clear();
+        err.clear();
+        file.clear();
+        for (size_t i = 0; i < count; ++i) {
+            std::string& target = (batch[i].level == Level::ERROR || logToStderr_) ? err : out;
+            target += batch[i].text;
+            target += '\n';
+            file += batch[i].text;
+            file += '\n';
+        }
+        if (dropped != 0) {
+            const std::string line = "[" + getCurrentTime() + "] [WARNING] [Logger] " +
+                                     std::to_string(dropped) + " records dropped, log queue is full\n";
+            err += line;
+            file += line;
+        }
+
+        if (logToConsole_) {
+            if (!out.empty()) std::cout.write(out.data(), static_cast<std::streamsize>(out.size())).flush();
+            if (!err.empty()) std::cerr.write(err.data(), static_cast<std::streamsize>(err.size())).flush();
+        }
+        if (logToFile_ && logFile_.is_open()) {
+            logFile_.write(file.data(), static_cast<std::streamsize>(file.size())).flush();
+        }
+        written_.fetch_add(count, std::memory_order_release);
+    }
+}
+
+void Logger::setAsync(bool enable, size_t queue_size, FullPolicy policy) {
+    stopWriter();
+    if (!enable) {
+        return;
+    }
+
+    queue_ = std::make_unique<RingBuffer<Record>>(queue_size);
+    policy_ = policy;
+    stop_.store(false);
+    writer_ = std::thread([this]() { writerLoop(); });
+    async_.store(true, std::memory_order_release);
+}
+
+void Logger::flush() {
+    if (!async_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        std::cout.flush();
+        if (logFile_.is_open()) logFile_.flush();
+        return;
+    }
+    while (written_.load(std::memory_order_acquire) < pushed_.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void Logger::stopWriter() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    async_.store(false, std::memory_order_release);
+    stop_.store(true, std::memory_order_release);
+    wake_.fetch_add(1, std::memory_order_release);
+    wake_.notify_one();
+    writer_.join();
+    queue_.reset();
+}
+
 void Logger::info(const std::string& message, const std::string& component) {
     log(Level::INFO, message, component);
 }
@@ -79,10 +211,11 @@ void Logger::debug(const std::string& message, const std::string& component) {
 }
 
 void Logger::setLogLevel(Level level) {
-    currentLevel_ = level;
+    currentLevel_.store(level, std::memory_order_relaxed);
 }
 
 void Logger::setLogToFile(bool enable) {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
     logToFile_ = enable;
     if (enable && !logFile_.is_open() && !logFilePath_.empty()) {
         logFile_.open(logFilePath_, std::ios::app);
@@ -90,10 +223,17 @@ void Logger::setLogToFile(bool enable) {
 }
 
 void Logger::setLogToConsole(bool enable) {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
     logToConsole_ = enable;
 }
 
+void Logger::setLogToStderr(bool enable) {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    logToStderr_ = enable;
+}
+
 void Logger::setLogFile(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
     logFilePath_ = filename;
     if (logFile_.is_open()) {
         logFile_.close();
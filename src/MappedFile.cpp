@@ -0,0 +1,143 @@
+#include "MappedFile.hpp"
+#include "Logger.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FANO_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LOG Logger::getInstance()
+
+MappedFile::MappedFile(MappedFile&& other) noexcept{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept{
+    if(this != &other){
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        open_ = std::exchange(other.open_, false);
+        mapped_ = std::exchange(other.mapped_, false);
+        buffer_ = std::exchange(other.buffer_, nullptr);
+        capacity_ = std::exchange(other.capacity_, 0);
+    }
+    return *this;
+}
+
+void MappedFile::open(const std::string& path){
+    close();
+    if(path == STDIN_PATH){
+        read_blocks(std::cin, "stdin");
+    }
+    else if(!map(path)){
+        std::ifstream input_file(path, std::ios::binary);
+        if(!input_file.is_open()){
+            LOG.error("Error in opening file " + path, "MappedFile::open");
+            throw std::runtime_error("Error in opening file");
+        }
+        read_blocks(input_file, path);
+    }
+    open_ = true;
+    LOG.info("Input " + path + " opened, " + std::to_string(size_) + " bytes" +
+             (mapped_ ? " (mapped)" : " (buffered)"), "MappedFile::open");
+}
+
+void MappedFile::open(std::istream& input, std::span<const uint8_t> head, const std::string& name){
+    close();
+    reserve(head.size() + BLOCK_SIZE);
+    if(!head.empty()){
+        std::memcpy(buffer_, head.data(), head.size());
+    }
+    size_ = head.size();
+    read_blocks(input, name);
+    open_ = true;
+    LOG.info("Input " + name + " opened, " + std::to_string(size_) + " bytes (buffered)", "MappedFile::open");
+}
+
+void MappedFile::close(){
+#ifdef FANO_HAS_MMAP
+    if(mapped_){
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    if(buffer_){
+        ::operator delete[](buffer_, std::align_val_t{ALIGNMENT});
+    }
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    mapped_ = false;
+    buffer_ = nullptr;
+    capacity_ = 0;
+}
+
+bool MappedFile::map(const std::string& path){
+#ifdef FANO_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        LOG.error("Error in opening file " + path, "MappedFile::map");
+        throw std::runtime_error("Error in opening file");
+    }
+
+    struct stat st{};
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0){
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED){
+        LOG.warning("mmap failed for " + path + ", falling back to block reads", "MappedFile::map");
+        return false;
+    }
+    madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    data_ = static_cast<const uint8_t*>(addr);
+    size_ = static_cast<size_t>(st.st_size);
+    mapped_ = true;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void MappedFile::reserve(size_t capacity){
+    if(capacity <= capacity_) return;
+    auto* bigger = static_cast<uint8_t*>(::operator new[](capacity, std::align_val_t{ALIGNMENT}));
+    if(buffer_){
+        std::memcpy(bigger, buffer_, size_);
+        ::operator delete[](buffer_, std::align_val_t{ALIGNMENT});
+    }
+    buffer_ = bigger;
+    capacity_ = capacity;
+}
+
+void MappedFile::read_blocks(std::istream& input_file, const std::string& path){
+    while(true){
+        if(size_ + BLOCK_SIZE > capacity_){
+            reserve(capacity_ == 0 ? BLOCK_SIZE : capacity_ * 2);
+        }
+        input_file.read(reinterpret_cast<char*>(buffer_ + size_), static_cast<std::streamsize>(BLOCK_SIZE));
+        size_ += static_cast<size_t>(input_file.gcount());
+        if(!input_file){
+            break;
+        }
+    }
+    if(input_file.bad()){
+        LOG.error("Error in reading file " + path, "MappedFile::read_blocks");
+        throw std::runtime_error("Error in reading file");
+    }
+    data_ = buffer_;
+}
@@ -0,0 +1,127 @@
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#define LOG Logger::getInstance()
+
+namespace{
+
+void append_number(std::string& out, double value){
+    if(!std::isfinite(value)){
+        out += "null";
+        return;
+    }
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+// Names and file paths: quotes, backslashes and control characters are escaped
+void append_string(std::string& out, const std::string& value){
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for(char c : value){
+        const auto u = static_cast<unsigned char>(c);
+        if(u < 0x20){
+            out += "\\u00";
+            out += hex[u >> 4];
+            out += hex[u & 0xF];
+            continue;
+        }
+        if(c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    out += '"';
+}
+
+}
+
+void Metrics::add_phase(const std::string& name, double seconds){
+    total_seconds += seconds;
+    for(auto& phase : phases){
+        if(phase.name == name){
+            phase.seconds += seconds;
+            return;
+        }
+    }
+    phases.push_back({name, seconds});
+}
+
+double Metrics::average_code_length() const{
+    return symbols == 0 ? 0.0 : static_cast<double>(payload_bits) / static_cast<double>(symbols);
+}
+
+double Metrics::throughput_mbps() const{
+    return total_seconds <= 0 ? 0.0 : static_cast<double>(symbols) / total_seconds / 1e6;
+}
+
+std::string Metrics::to_json() const{
+    std::string out = "{\"engine\":";
+    append_string(out, engine);
+    out += ",\"operation\":";
+    append_string(out, operation);
+    if(!input.empty()){
+        out += ",\"input\":";
+        append_string(out, input);
+    }
+    out += ",\"bytes_in\":" + std::to_string(bytes_in);
+    out += ",\"bytes_out\":" + std::to_string(bytes_out);
+    out += ",\"symbols\":" + std::to_string(symbols);
+    out += ",\"payload_bits\":" + std::to_string(payload_bits);
+    out += ",\"average_code_length\":";
+    append_number(out, average_code_length());
+    out += ",\"entropy\":";
+    if(entropy){
+        append_number(out, *entropy);
+    }
+    else{
+        out += "null";
+    }
+    out += ",\"total_seconds\":";
+    append_number(out, total_seconds);
+    out += ",\"throughput_mbps\":";
+    append_number(out, throughput_mbps());
+    out += ",\"phases\":[";
+    for(size_t i = 0; i < phases.size(); ++i){
+        if(i != 0) out += ',';
+        out += "{\"name\":";
+        append_string(out, phases[i].name);
+        out += ",\"seconds\":";
+        append_number(out, phases[i].seconds);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+void Metrics::write_json(const std::string& path) const{
+    std::ofstream output_file(path);
+    if(!output_file.is_open()){
+        LOG.error("Error in opening file " + path, "Metrics::write_json");
+        throw std::runtime_error("Error in opening file");
+    }
+    output_file << to_json() << '\n';
+    if(!output_file){
+        LOG.error("Error in writing file " + path, "Metrics::write_json");
+        throw std::runtime_error("Error in writing file");
+    }
+}
+
+double Metrics::entropy_of(const std::array<uint64_t, 256>& counts){
+    uint64_t total = 0;
+    for(uint64_t count : counts){
+        total += count;
+    }
+    if(total == 0) return 0.0;
+
+    double entropy = 0;
+    for(uint64_t count : counts){
+        if(count == 0) continue;
+        const double p = static_cast<double>(count) / static_cast<double>(total);
+        entropy -= p * std::log2(p);
+    }
+    return entropy;
+}
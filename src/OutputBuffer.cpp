@@ -0,0 +1,24 @@
+#include "OutputBuffer.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#define LOG Logger::getInstance()
+
+OutputBuffer::OutputBuffer(std::ostream& output, size_t preview_size, size_t size)
+    : output_(output), buffer_(std::max<size_t>(size, 1)), preview_size_(preview_size) {}
+
+void OutputBuffer::flush(){
+    if(preview_.size() < preview_size_){
+        size_t n = std::min(preview_size_ - preview_.size(), pos_);
+        preview_.append(reinterpret_cast<const char*>(buffer_.data()), n);
+    }
+
+    output_.write(reinterpret_cast<const char*>(buffer_.data()), static_cast<std::streamsize>(pos_));
+    if(!output_){
+        LOG.error("Error in writing decoded data", "OutputBuffer::flush");
+        throw std::runtime_error("Error in writing file");
+    }
+    flushed_ += pos_;
+    pos_ = 0;
+}
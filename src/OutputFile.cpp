@@ -0,0 +1,37 @@
+#include "OutputFile.hpp"
+#include "Logger.hpp"
+#include <iostream>
+#include <stdexcept>
+
+#define LOG Logger::getInstance()
+
+void OutputFile::reserve_stdout(const std::string& path){
+    if(is_stdout_path(path)){
+        // Console log lines would end up inside the data
+        LOG.setLogToStderr(true);
+    }
+}
+
+void OutputFile::open(const std::string& path){
+    path_ = path;
+    if(is_stdout_path(path)){
+        reserve_stdout(path);
+        stream_ = &std::cout;
+        return;
+    }
+
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if(!file_.is_open()){
+        LOG.error("Error in opening file " + path, "OutputFile::open");
+        throw std::runtime_error("Error in opening file");
+    }
+    stream_ = &file_;
+}
+
+void OutputFile::flush(){
+    stream_->flush();
+    if(!*stream_){
+        LOG.error("Error in writing file " + path_, "OutputFile::flush");
+        throw std::runtime_error("Error in writing file");
+    }
+}
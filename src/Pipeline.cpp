@@ -0,0 +1,379 @@
+#include "Pipeline.hpp"
+#include "IoRing.hpp"
+#include "Logger.hpp"
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FANO_HAS_PREAD 1
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#define LOG Logger::getInstance()
+
+namespace{
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start){
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Requests of a ring stage: a buffer and how much of it is done
+struct Slot{
+    Pipeline::Buffer buffer;
+    size_t done = 0;
+    bool busy = false;
+    bool ready = false;
+};
+
+}
+
+bool Pipeline::supported(){
+#ifdef FANO_HAS_PREAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* Pipeline::name(Io io){
+    switch(io){
+        case Io::Auto: return "auto";
+        case Io::Threads: return "threads";
+        case Io::IoUring: return "io_uring";
+    }
+    return "unknown";
+}
+
+Pipeline::Pipeline(const std::string& input_path, const std::string& output_path, uint64_t output_size,
+Io io, size_t depth)
+    : input_path_(input_path), output_path_(output_path), output_(output_path, output_size),
+    io_(io), depth_(depth < 1 ? 1 : depth){
+#ifdef FANO_HAS_PREAD
+    input_fd_ = ::open(input_path.c_str(), O_RDONLY);
+#endif
+    if(input_fd_ < 0){
+        LOG.error("Error in opening file " + input_path, "Pipeline::Pipeline");
+        throw std::runtime_error("Error in opening file");
+    }
+
+    const bool ring = IoRing::supported() && output_.handle() >= 0;
+    if(io_ == Io::IoUring && !ring){
+        LOG.warning("io_uring is not available, reading and writing on threads", "Pipeline::Pipeline");
+    }
+    io_ = io_ != Io::Threads && ring ? Io::IoUring : Io::Threads;
+}
+
+Pipeline::~Pipeline(){
+#ifdef FANO_HAS_PREAD
+    if(input_fd_ >= 0){
+        ::close(input_fd_);
+    }
+#endif
+}
+
+void Pipeline::fail(std::exception_ptr error){
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if(!error_){
+            error_ = std::move(error);
+        }
+    }
+    read_full_->close();
+    read_free_->close();
+    write_full_->close();
+    write_free_->close();
+}
+
+void Pipeline::run(const std::vector<Range>& ranges, const Coder& coder){
+    read_full_ = std::make_unique<SpscQueue<Buffer>>(depth_);
+    read_free_ = std::make_unique<SpscQueue<Buffer>>(depth_);
+    write_full_ = std::make_unique<SpscQueue<Buffer>>(depth_);
+    write_free_ = std::make_unique<SpscQueue<Buffer>>(depth_);
+    error_ = nullptr;
+    for(size_t i = 0; i < depth_; ++i){
+        Buffer in;
+        Buffer out;
+        read_free_->push(in);
+        write_free_->push(out);
+    }
+
+    LOG.info("Pipeline of " + std::to_string(ranges.size()) + " reads, " + std::to_string(depth_) +
+             " buffers per stage, I/O " + name(io_), "Pipeline::run");
+
+    std::thread reader([&]() {
+        try{
+            if(io_ == Io::IoUring){
+                read_ring(ranges);
+            }
+            else{
+                read_threads(ranges);
+            }
+        }
+        catch(...){
+            fail(std::current_exception());
+        }
+    });
+    std::thread writer([&]() {
+        try{
+            if(io_ == Io::IoUring){
+                write_ring();
+            }
+            else{
+                write_threads();
+            }
+        }
+        catch(...){
+            fail(std::current_exception());
+        }
+    });
+
+    // Coder stage
+    try{
+        Buffer in;
+        Buffer out;
+        while(true){
+            const auto wait_start = Clock::now();
+            if(!read_full_->pop(in) || !write_free_->pop(out)){
+                break;
+            }
+            stall_seconds_ += seconds_since(wait_start);
+            out.data.clear();
+            out.offset = 0;
+            out.index = in.index;
+            coder(in, out);
+            read_free_->push(in);
+            if(!write_full_->push(out)){
+                break;
+            }
+        }
+    }
+    catch(...){
+        fail(std::current_exception());
+    }
+    write_full_->close();
+    reader.join();
+    writer.join();
+    if(error_){
+        std::rethrow_exception(error_);
+    }
+}
+
+void Pipeline::read_at(uint64_t offset, uint8_t* data, size_t size){
+#ifdef FANO_HAS_PREAD
+    while(size != 0){
+        const ssize_t got = ::pread(input_fd_, data, size, static_cast<off_t>(offset));
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got <= 0){
+            LOG.error("Error in reading file " + input_path_ + " at " + std::to_string(offset), "Pipeline::read_at");
+            throw std::runtime_error(got == 0 ? "File is shorter than expected" : "Error in reading file");
+        }
+        data += got;
+        size -= static_cast<size_t>(got);
+        offset += static_cast<uint64_t>(got);
+    }
+#else
+    (void)offset;
+    (void)data;
+    (void)size;
+    throw std::runtime_error("Positional reads are not supported");
+#endif
+}
+
+void Pipeline::write_at(uint64_t offset, const uint8_t* data, size_t size){
+    output_.write_at(offset, data, size);
+}
+
+void Pipeline::close(){
+    output_.close();
+}
+
+void Pipeline::read_threads(const std::vector<Range>& ranges){
+    Buffer buffer;
+    for(size_t i = 0; i < ranges.size(); ++i){
+        if(!read_free_->pop(buffer)){
+            return;
+        }
+        const auto start = Clock::now();
+        buffer.data.resize(ranges[i].size);
+        buffer.offset = ranges[i].offset;
+        buffer.index = i;
+        read_at(buffer.offset, buffer.data.data(), buffer.data.size());
+        read_seconds_ += seconds_since(start);
+        if(!read_full_->push(buffer)){
+            return;
+        }
+    }
+    read_full_->close();
+}
+
+void Pipeline::write_threads(){
+    Buffer buffer;
+    while(write_full_->pop(buffer)){
+        const auto start = Clock::now();
+        output_.write_at(buffer.offset, buffer.data.data(), buffer.data.size());
+        write_seconds_ += seconds_since(start);
+        write_free_->push(buffer);
+    }
+}
+
+// Reads complete in any order, buffers go to the coder in range order.
+// Range i is in slot i % depth, at most depth ranges are between the next
+// to read and the next to pass on, since there are only depth buffers
+void Pipeline::read_ring(const std::vector<Range>& ranges){
+    std::vector<Slot> slots(depth_);
+    IoRing ring(static_cast<unsigned>(depth_));
+    auto submit = [&](size_t i){
+        Slot& slot = slots[i % depth_];
+        ring.read(input_fd_, slot.buffer.data.data() + slot.done, slot.buffer.data.size() - slot.done,
+                  slot.buffer.offset + slot.done, i);
+    };
+
+    try{
+        size_t next_read = 0;
+        size_t next_pass = 0;
+        while(next_pass < ranges.size()){
+            // Start reads while there are empty buffers, waiting for one only when nothing is in flight
+            while(next_read < ranges.size() && next_read - next_pass < depth_ && !slots[next_read % depth_].busy){
+                Slot& slot = slots[next_read % depth_];
+                const bool idle = ring.pending() == 0 && !slots[next_pass % depth_].ready;
+                if(!(idle ? read_free_->pop(slot.buffer) : read_free_->try_pop(slot.buffer))){
+                    if(idle){
+                        return;
+                    }
+                    break;
+                }
+                slot.buffer.data.resize(ranges[next_read].size);
+                slot.buffer.offset = ranges[next_read].offset;
+                slot.buffer.index = next_read;
+                slot.done = 0;
+                slot.busy = true;
+                slot.ready = slot.buffer.data.empty();
+                if(!slot.ready){
+                    submit(next_read);
+                }
+                ++next_read;
+            }
+
+            // Pass finished buffers on in order
+            while(next_pass < next_read && slots[next_pass % depth_].ready){
+                Slot& slot = slots[next_pass % depth_];
+                slot.busy = slot.ready = false;
+                if(!read_full_->push(slot.buffer)){
+                    return;
+                }
+                ++next_pass;
+            }
+            if(ring.pending() == 0){
+                continue;
+            }
+
+            const auto start = Clock::now();
+            const IoRing::Completion completion = ring.wait();
+            read_seconds_ += seconds_since(start);
+            Slot& slot = slots[completion.tag % depth_];
+            if(completion.result == -EINTR || completion.result == -EAGAIN){
+                submit(completion.tag);
+                continue;
+            }
+            if(completion.result <= 0){
+                LOG.error("Error in reading file " + input_path_ + " at " + std::to_string(slot.buffer.offset + slot.done) +
+                          ", result " + std::to_string(completion.result), "Pipeline::read_ring");
+                throw std::runtime_error(completion.result == 0 ? "File is shorter than expected" : "Error in reading file");
+            }
+            slot.done += static_cast<size_t>(completion.result);
+            if(slot.done < slot.buffer.data.size()){
+                submit(completion.tag);
+            }
+            else{
+                slot.ready = true;
+            }
+        }
+    }
+    catch(...){
+        // The kernel may still be writing into the buffers
+        while(ring.pending() != 0){
+            ring.wait();
+        }
+        throw;
+    }
+    read_full_->close();
+}
+
+// Writes are independent, a buffer goes back as soon as all of it is written
+void Pipeline::write_ring(){
+    std::vector<Slot> slots(depth_);
+    IoRing ring(static_cast<unsigned>(depth_));
+    const int fd = output_.handle();
+    auto submit = [&](size_t i){
+        Slot& slot = slots[i];
+        ring.write(fd, slot.buffer.data.data() + slot.done, slot.buffer.data.size() - slot.done,
+                   slot.buffer.offset + slot.done, i);
+    };
+
+    try{
+        bool open = true;
+        while(open || ring.pending() != 0){
+            size_t free = 0;
+            while(free < depth_ && slots[free].busy){
+                ++free;
+            }
+            if(open && free < depth_){
+                Slot& slot = slots[free];
+                const bool idle = ring.pending() == 0;
+                if(idle ? write_full_->pop(slot.buffer) : write_full_->try_pop(slot.buffer)){
+                    slot.done = 0;
+                    if(slot.buffer.data.empty()){
+                        write_free_->push(slot.buffer);
+                    }
+                    else{
+                        slot.busy = true;
+                        submit(free);
+                    }
+                    continue;
+                }
+                if(idle){
+                    open = false;
+                    continue;
+                }
+            }
+
+            const auto start = Clock::now();
+            const IoRing::Completion completion = ring.wait();
+            write_seconds_ += seconds_since(start);
+            Slot& slot = slots[completion.tag];
+            if(completion.result == -EINTR || completion.result == -EAGAIN){
+                submit(completion.tag);
+                continue;
+            }
+            if(completion.result <= 0){
+                LOG.error("Error in writing file " + output_path_ + " at " + std::to_string(slot.buffer.offset + slot.done) +
+                          ", result " + std::to_string(completion.result), "Pipeline::write_ring");
+                throw std::runtime_error("Error in writing file");
+            }
+            slot.done += static_cast<size_t>(completion.result);
+            if(slot.done < slot.buffer.data.size()){
+                submit(completion.tag);
+            }
+            else{
+                slot.busy = false;
+                write_free_->push(slot.buffer);
+            }
+        }
+    }
+    catch(...){
+        while(ring.pending() != 0){
+            ring.wait();
+        }
+        throw;
+    }
+}
@@ -0,0 +1,93 @@
+#include "PositionalFile.hpp"
+#include "Logger.hpp"
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FANO_HAS_PWRITE 1
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#define LOG Logger::getInstance()
+
+PositionalFile::PositionalFile(const std::string& path, uint64_t size) : path_(path){
+#ifdef FANO_HAS_PWRITE
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd_ < 0){
+        LOG.error("Error in opening file " + path, "PositionalFile::PositionalFile");
+        throw std::runtime_error("Error in opening file");
+    }
+    if(::ftruncate(fd_, static_cast<off_t>(size)) != 0){
+        ::close(fd_);
+        fd_ = -1;
+        LOG.error("Error in sizing file " + path + " to " + std::to_string(size) + " bytes", "PositionalFile::PositionalFile");
+        throw std::runtime_error("Error in writing file");
+    }
+#else
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if(!file_.is_open()){
+        LOG.error("Error in opening file " + path, "PositionalFile::PositionalFile");
+        throw std::runtime_error("Error in opening file");
+    }
+    (void)size;
+#endif
+}
+
+PositionalFile::~PositionalFile(){
+    try{
+        close();
+    }
+    catch(const std::exception&){
+        // Already logged, a destructor can not report it
+    }
+}
+
+void PositionalFile::write_at(uint64_t offset, const uint8_t* data, size_t size){
+#ifdef FANO_HAS_PWRITE
+    while(size != 0){
+        const ssize_t written = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+        if(written < 0 && errno == EINTR){
+            continue;
+        }
+        if(written <= 0){
+            LOG.error("Error in writing file " + path_ + " at " + std::to_string(offset), "PositionalFile::write_at");
+            throw std::runtime_error("Error in writing file");
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+#else
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.seekp(static_cast<std::streamoff>(offset));
+    file_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if(!file_){
+        LOG.error("Error in writing file " + path_ + " at " + std::to_string(offset), "PositionalFile::write_at");
+        throw std::runtime_error("Error in writing file");
+    }
+#endif
+}
+
+void PositionalFile::close(){
+#ifdef FANO_HAS_PWRITE
+    if(fd_ >= 0){
+        const int result = ::close(fd_);
+        fd_ = -1;
+        if(result != 0){
+            LOG.error("Error in closing file " + path_, "PositionalFile::close");
+            throw std::runtime_error("Error in writing file");
+        }
+    }
+#else
+    if(file_.is_open()){
+        file_.close();
+        if(!file_){
+            LOG.error("Error in closing file " + path_, "PositionalFile::close");
+            throw std::runtime_error("Error in writing file");
+        }
+    }
+#endif
+}
@@ -0,0 +1,74 @@
+#include "SyncIndex.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#define LOG Logger::getInstance()
+
+size_t SyncIndex::find(uint64_t offset) const{
+    auto it = std::upper_bound(points.begin(), points.end(), offset,
+        [](uint64_t value, const Point& point) { return value < point.output_offset; });
+    return it == points.begin() ? 0 : static_cast<size_t>(it - points.begin()) - 1;
+}
+
+void SyncIndex::write(const std::string& path) const{
+    std::ofstream output_file(path);
+    if(!output_file.is_open()){
+        LOG.error("Error in opening file " + path, "SyncIndex::write");
+        throw std::runtime_error("Error in opening file");
+    }
+
+    output_file << interval << ' ' << total_symbols << ' ' << total_bits << ' ' << points.size() << '\n';
+    for(const auto& point : points){
+        output_file << point.bit_offset << ' ' << point.output_offset << '\n';
+    }
+    if(!output_file){
+        LOG.error("Error in writing file " + path, "SyncIndex::write");
+        throw std::runtime_error("Error in writing file");
+    }
+    LOG.info("Sync index written: " + std::to_string(points.size()) + " points", "SyncIndex::write");
+}
+
+void SyncIndex::read(const std::string& path){
+    std::ifstream input_file(path);
+    if(!input_file.is_open()){
+        LOG.error("Error in opening file " + path, "SyncIndex::read");
+        throw std::runtime_error("Error in opening file");
+    }
+
+    uint64_t count = 0;
+    input_file >> interval >> total_symbols >> total_bits >> count;
+    // A point every interval symbols, checked before the count is trusted with an allocation
+    if(!input_file || (count != 0 && (interval == 0 || count > total_symbols / interval + 1))){
+        LOG.error("Invalid sync index " + path + ": " + std::to_string(count) + " points", "SyncIndex::read");
+        throw std::runtime_error("Invalid sync index");
+    }
+    points.assign(static_cast<size_t>(count), {});
+    for(auto& point : points){
+        input_file >> point.bit_offset >> point.output_offset;
+    }
+    if(!input_file){
+        LOG.error("Invalid sync index " + path, "SyncIndex::read");
+        throw std::runtime_error("Invalid sync index");
+    }
+
+    check(path);
+}
+
+void SyncIndex::check(const std::string& source) const{
+    if(!points.empty() && (points[0].bit_offset != 0 || points[0].output_offset != 0)){
+        LOG.error("First sync point is not at the stream start in " + source, "SyncIndex::check");
+        throw std::runtime_error("Invalid sync index");
+    }
+    for(size_t i = 1; i < points.size(); ++i){
+        if(points[i].bit_offset < points[i - 1].bit_offset || points[i].output_offset <= points[i - 1].output_offset){
+            LOG.error("Sync points are not in order in " + source, "SyncIndex::check");
+            throw std::runtime_error("Invalid sync index");
+        }
+    }
+    if(!points.empty() && (points.back().bit_offset > total_bits || points.back().output_offset > total_symbols)){
+        LOG.error("Sync points are out of stream bounds in " + source, "SyncIndex::check");
+        throw std::runtime_error("Invalid sync index");
+    }
+}
@@ -0,0 +1,43 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads){
+    if(threads == 0){
+        threads = hardware_threads();
+    }
+    workers_.reserve(threads);
+    for(unsigned i = 0; i < threads; ++i){
+        workers_.emplace_back([this]() { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for(auto& worker : workers_){
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::hardware_threads(){
+    unsigned threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+void ThreadPool::run(){
+    while(true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if(tasks_.empty()){
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
@@ -1,9 +1,22 @@
 #include "UniDecoder.hpp"
+#include "Container.hpp"
+#include "ContainerStream.hpp"
 #include "Logger.hpp"
 #include "Decoder.hpp"
+#include "OutputBuffer.hpp"
+#include "OutputFile.hpp"
+#include "PositionalFile.hpp"
+#include "ThreadPool.hpp"
+#include "UniformKernels.hpp"
 #include <cstddef>
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
 #include <stdexcept>
 #include <string>
 
@@ -30,19 +43,24 @@ void UniDecoder::read_alphabet(std::ifstream& input_file){
                 throw std::runtime_error("Codes have not same size");
             }
             length_ = code.size();
+            if(length_ > 8){
+                LOG.error("Incorrect legth of code " + std::to_string(length_), "UniDecoder::read_alphabet");
+                throw std::runtime_error("Incorrect legth of code");
+            }
             unsigned int idx = code_string_to_uint(code);
-            codeToSymb_[idx] = symbol;
-            LOG.debug("Symbol: " + token + " -> Code: " + code, "Decoder::read_alphabet");
+            symbols_.value[idx] = symbol;
+            symbols_.valid[idx] = true;
+            LOG_DEBUG("Symbol: {} -> Code: {}", "UniDecoder::read_alphabet", token, code);
         } catch (const std::exception& e) {
             LOG.error("Failed to parse symbol token: " + token + " - " + e.what(), "Decoder::read_alphabet");
             throw;
         }
     }
+    bind_kernels();
+}
 
-    if(length_ > 8){
-        LOG.error("Incorrect legth of code " + std::to_string(length_), "UniDecoder::read_alphabet");
-        throw std::runtime_error("Incorrect legth of code");
-    }
+void UniDecoder::bind_kernels(){
+    kernels_ = length_ == 0 ? UniformKernels::Kernels{} : UniformKernels::for_width(length_);
 }
 
 unsigned int UniDecoder::code_string_to_uint(const std::string &s) {
@@ -64,156 +82,312 @@ unsigned int UniDecoder::code_string_to_uint(const std::string &s) {
     return result;
 }
 
-void UniDecoder::bit_decode(std::ifstream& input_file){
-    if(!input_file.is_open()){
-        LOG.error("Error in opening file " + input_path_text_, "UniDecoder::bit_decode");
-        throw std::runtime_error("Error in opening file");
+void UniDecoder::bit_decode(const uint8_t* data, size_t size, unsigned padding, OutputBuffer& output){
+    decode_segment(make_segment(data, size, padding), output);
+}
+
+UniDecoder::Segment UniDecoder::make_segment(const uint8_t* data, size_t size, unsigned padding) const{
+    if (padding > 7 || (size == 0 && padding != 0)) {
+        LOG.error("Invalid padding value", "UniDecoder::make_segment");
+        throw std::runtime_error("Invalid padding value");
     }
 
-    std::ofstream output_file(output_path_);
-    if(!output_file.is_open()){
-        LOG.error("Error in opening file " + output_path_, "UniDecoder::bit_decode");
-        throw std::runtime_error("Error in opening file");
+    Segment segment;
+    segment.payload = data;
+    segment.bit_count = uint64_t{size} * 8 - padding;
+    segment.length = length_;
+    segment.kernels = kernels_;
+    segment.map = symbols_;
+    if(length_ == 0 || segment.bit_count % length_ != 0){
+        if(length_ == 0 && segment.bit_count == 0){
+            return segment;
+        }
+        LOG.error("Remaining unmatched bits at the end of file", "UniDecoder::make_segment");
+        throw std::runtime_error("Corrupted file: unmatched trailing bits");
     }
+    segment.symbols = segment.bit_count / length_;
+    return segment;
+}
 
-    uint8_t padding = 0;
-    input_file.read(reinterpret_cast<char *>(&padding), sizeof(padding));
-    if(input_file.gcount() != sizeof(padding)){
-        LOG.error("Error in reading file " + input_path_text_, "UniDecoder::bit_decode");
-        throw std::runtime_error("Error in reading file");
+void UniDecoder::decode_symbols(const Segment& segment, uint64_t from, uint64_t to, uint8_t* out){
+    if(from >= to){
+        return;
     }
-    if (padding > 7) {
-        LOG.error("Invalid padding value", "UniDecoder::bit_decode");
-        throw std::runtime_error("Invalid padding value");
+    // Codes are unpacked into out and mapped to symbols in place. Every group
+    // of 8 codes starts on a whole byte, a range starting inside one decodes it aside
+    uint8_t* const codes = out;
+    uint64_t at = from;
+    if(at % 8 != 0){
+        uint8_t group[8];
+        const uint64_t first = at - at % 8;
+        const uint64_t n = std::min<uint64_t>(8, segment.symbols - first);
+        segment.kernels.unpack(segment.payload + first / 8 * segment.length, static_cast<size_t>(n), group);
+        const uint64_t take = std::min(first + n, to) - at;
+        std::memcpy(out, group + at % 8, static_cast<size_t>(take));
+        out += take;
+        at += take;
+    }
+    if(at < to){
+        segment.kernels.unpack(segment.payload + at / 8 * segment.length, static_cast<size_t>(to - at), out);
     }
 
-    uint8_t current = 0;
-    uint8_t k = 0;
-    uint8_t temp = 0;            // хранит частичный код (старшие биты)
-    size_t read_bit_in_code = 0; // сколько бит ещё нужно докопать до полного length_
-
-    const unsigned BITS_PER_BYTE = 8;
-    const unsigned CODE_MASK = (length_ == 8) ? 0xFFu : ((1u << length_) - 1u);
-
-    std::string code;
-    code.reserve(length_);
+    const size_t count = static_cast<size_t>(to - from);
+    if(UniformKernels::map(codes, count, segment.map, codes) != count){
+        LOG.error("Code is not in dictionary", "UniDecoder::decode_symbols");
+        throw std::runtime_error("Code is not in dictionary");
+    }
+}
 
-    while(input_file.read(reinterpret_cast<char *>(&current), sizeof(current))){
-        bool is_last = (input_file.peek() == EOF);
-        unsigned read_bit_in_byte = 0; // сколько бит уже прочитано в этом байте
-        unsigned invalid_bits = 0;
+void UniDecoder::decode_segment(const Segment& segment, OutputBuffer& output){
+    uint64_t done = 0;
+    while(done < segment.symbols){
+        if(output.available() < 8){
+            output.flush();
+        }
+        size_t n = static_cast<size_t>(std::min<uint64_t>(segment.symbols - done, output.available()));
+        if(done + n < segment.symbols){
+            n -= n % 8;
+        }
+        decode_symbols(segment, done, done + n, output.tail());
+        output.commit(n);
+        done += n;
+    }
+}
 
-        if(is_last && padding != 0){
-            invalid_bits = static_cast<unsigned>(padding);
+void UniDecoder::set_codes(const std::array<Code, 256>& codes){
+    symbols_ = UniformKernels::ByteMap{};
+    length_ = 0;
+    for(size_t symbol = 0; symbol < codes.size(); ++symbol){
+        if(codes[symbol].empty()){
+            continue;
+        }
+        if(length_ != 0 && length_ != codes[symbol].length){
+            LOG.error("Codes have not same size", "UniDecoder::set_codes");
+            throw std::runtime_error("Codes have not same size");
+        }
+        length_ = codes[symbol].length;
+        if(length_ > 8){
+            LOG.error("Incorrect legth of code " + std::to_string(length_), "UniDecoder::set_codes");
+            throw std::runtime_error("Incorrect legth of code");
         }
+        symbols_.value[static_cast<size_t>(codes[symbol].bits)] = static_cast<uint8_t>(symbol);
+        symbols_.valid[static_cast<size_t>(codes[symbol].bits)] = true;
+    }
+    bind_kernels();
+}
 
-        if(length_ < BITS_PER_BYTE){
-            while(read_bit_in_byte < BITS_PER_BYTE - invalid_bits){
-                if(read_bit_in_code != 0){
-                    unsigned need = length_ - read_bit_in_code; // сколько ещё нужно
-                    unsigned avail = BITS_PER_BYTE - invalid_bits - read_bit_in_byte; // сколько бит доступно сейчас
-                    unsigned take = (avail < need) ? avail : need; // сколько возьмём из current
+void UniDecoder::load(){
+    if(!segments_.empty()){
+        return;
+    }
+    if(!input_.is_open()){
+        input_.open(input_path_text_);
+    }
 
-                    // Извлечём 'take' бит из текущего байта, начиная со старших непрочитанных бит
-                    unsigned shift_right = BITS_PER_BYTE - (read_bit_in_byte + take);
-                    // Сдвигаем и зануляем все остальные
-                    uint8_t part = static_cast<uint8_t>((static_cast<unsigned>(current) >> shift_right) & ((1u << take) - 1u));
+    if(Container::is_container(input_.data(), input_.size())){
+        LOG.info("Input is a container, code table is read from it", "UniDecoder::load");
+        load_container();
+        return;
+    }
 
-                    // Разместим part в temp (temp хранит старшие биты кода)
-                    // Сдвинем part слево, если остались не считаные биты для кода
-                    // То есть оставим место для оставшихся битов
-                    temp = static_cast<uint8_t>(temp | static_cast<uint8_t>(part << (need - take)));
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
+    std::ifstream input_alphabet(input_path_alphabet_);
+    if(!input_alphabet.is_open()){
+        LOG.error("Error in opening file " + input_path_alphabet_, "UniDecoder::load");
+        throw std::runtime_error("Error in opening file");
+    }
+    read_alphabet(input_alphabet);
 
-                    read_bit_in_byte += take;
-                    read_bit_in_code += take;
+    // First byte is the number of padding bits in the last byte
+    if(input_.size() == 0){
+        LOG.error("Error in reading file " + input_path_text_, "UniDecoder::load");
+        throw std::runtime_error("Error in reading file");
+    }
+    segments_.push_back(make_segment(input_.data() + 1, input_.size() - 1, input_.data()[0]));
+}
 
-                    if(read_bit_in_code != length_){
-                        break;
-                    }
+void UniDecoder::load_container(){
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
+    const Container::Header header = Container::read_header(input_.data(), input_.size());
+    if(header.engine != Container::Engine::Uniform){
+        LOG.error("Container is not encoded with the Uniform engine", "UniDecoder::load_container");
+        throw std::runtime_error("Container is not encoded with the Uniform engine");
+    }
 
-                    // temp теперь содержит полный код
-                    k = temp;
-                    temp = 0;
-                    read_bit_in_code = 0;
+    uint64_t output_offset = 0;
+    for(const auto& entry : Container::read_directory(input_.data(), input_.size(), header)){
+        std::array<Code, 256> codes;
+        const size_t table_size = Container::read_codes(input_.data() + entry.offset, input_.size() - entry.offset, codes,
+                                                        header.max_code_length);
 
-                    // Накладывем маску чтобы явно занулить идущие впереди биты
-                    k = static_cast<uint8_t>(k & CODE_MASK);
+        set_codes(codes);
 
-                    if(codeToSymb_[k] == -1){
-                        LOG.error("Code is not in dictionary", "UniDecoder::bit_decode");
-                        throw std::runtime_error("Code is not in dictionary");
-                    }
-                    output_file.put(static_cast<unsigned char>(codeToSymb_[k]));
-                }
-                else{
-                    // Нет временного остатка — пытаемся взять код целиком из текущего байта
-                    unsigned avail = BITS_PER_BYTE - invalid_bits - read_bit_in_byte;
-                    if(avail < length_){
-                        // Не хватает бит в остатке байта -> сохраним их в temp
-                        unsigned take = avail; // = avail
-                        unsigned shift_right = BITS_PER_BYTE - (read_bit_in_byte + take);
-                        uint8_t part = static_cast<uint8_t>((static_cast<unsigned>(current) >> shift_right) & ((1u << take) - 1u));
-
-                        // Разместим эти take бит как старшие биты будущего кода
-                        temp = static_cast<uint8_t>(part << (length_ - take));
-                        read_bit_in_code += take;
-                        read_bit_in_byte += take;
-
-                        // перейдём к следующему байту для дополнения temp
-                    }
-                    else{
-                        // В оставшемся байте хватает места для целого кода
-                        unsigned shift_right = BITS_PER_BYTE - (read_bit_in_byte + length_);
-                        uint8_t code_bits = static_cast<uint8_t>((static_cast<unsigned>(current) >> shift_right) & CODE_MASK);
-
-                        if(codeToSymb_[code_bits] == -1){
-                            LOG.error("Code is not in dictionary", "UniDecoder::bit_decode");
-                            throw std::runtime_error("Code is not in dictionary");
-                        }
-
-                        output_file.put(static_cast<unsigned char>(codeToSymb_[code_bits]));
-                        read_bit_in_byte += length_;
-                        read_bit_in_code = 0;
-
-                    }
-                }
-            }
+        const uint64_t payload_offset = entry.offset + table_size;
+        const uint64_t payload_bytes = (entry.bit_count + 7) / 8;
+        if(length_ == 0 || payload_offset > input_.size() || payload_bytes > input_.size() - payload_offset){
+            LOG.error("Block is out of file bounds or has no codes", "UniDecoder::load_container");
+            throw std::runtime_error("Corrupted file: invalid block");
         }
-        else {
-            // length_ == 8 (по предпосылке)
-            if(codeToSymb_[current] == -1){
-                LOG.error("Code is not in dictionary", "UniDecoder::decode");
-                throw std::runtime_error("Code is not in dictionary");
-            }
-            output_file.put(static_cast<unsigned char>(codeToSymb_[current]));
+
+        Segment segment = make_segment(input_.data() + payload_offset, static_cast<size_t>(payload_bytes),
+                                       static_cast<unsigned>(payload_bytes * 8 - entry.bit_count));
+        if(segment.symbols != entry.raw_size){
+            LOG.error("Block holds " + std::to_string(segment.symbols) + " symbols instead of " +
+                      std::to_string(entry.raw_size), "UniDecoder::load_container");
+            throw std::runtime_error("Error in decode");
         }
+        segment.output_offset = output_offset;
+        output_offset += segment.symbols;
+        segments_.push_back(std::move(segment));
     }
+}
 
-    if (temp != 0 || read_bit_in_code != 0) {
-        LOG.error("Remaining unmatched bits at the end of file", "UniDecoder::bit_decode");
-        throw std::runtime_error("Corrupted file: unmatched trailing bits");
+std::vector<unsigned char> UniDecoder::decode_range(uint64_t begin, uint64_t end){
+    load();
+    if(begin > end){
+        LOG.error("Invalid range " + std::to_string(begin) + "-" + std::to_string(end), "UniDecoder::decode_range");
+        throw std::invalid_argument("Invalid range");
+    }
+
+    std::vector<unsigned char> out(static_cast<size_t>(end - begin));
+    uint64_t decoded = 0;
+    for(const Segment& segment : segments_){
+        const uint64_t segment_end = segment.output_offset + segment.symbols;
+        if(segment_end <= begin || segment.output_offset >= end){
+            continue;
+        }
+        const uint64_t from = std::max(begin, segment.output_offset);
+        const uint64_t to = std::min(end, segment_end);
+        decode_symbols(segment, from - segment.output_offset, to - segment.output_offset, out.data() + (from - begin));
+        decoded += to - from;
     }
+
+    if(decoded != end - begin){
+        LOG.error("Range end " + std::to_string(end) + " is past the end of the file", "UniDecoder::decode_range");
+        throw std::out_of_range("Range is past the end of the file");
+    }
+    return out;
+}
+
+void UniDecoder::parallel_decode(uint64_t total){
+    PositionalFile output(output_path_, total);
+
+    // Declared last so that its destructor waits for tasks still in flight
+    ThreadPool pool(threads_);
+
+    // A few slices per thread, so one slow slice does not idle the others. Slices
+    // are whole groups of 8 codes, 8 * length bits, a multiple of lcm(length, 8):
+    // every slice starts on a byte and at a known output offset
+    uint64_t slice = std::max<uint64_t>(SLICE_SIZE, total / (4 * pool.size()));
+    slice += (8 - slice % 8) % 8;
+
+    std::vector<std::future<void>> tasks;
+    for(const Segment& segment : segments_){
+        for(uint64_t from = 0; from < segment.symbols; from += slice){
+            const uint64_t to = std::min(from + slice, segment.symbols);
+            tasks.push_back(pool.submit([&segment, &output, from, to]() {
+                // Decoded in pieces, memory does not grow with the slice
+                std::vector<uint8_t> piece(static_cast<size_t>(std::min(SLICE_SIZE, to - from)));
+                for(uint64_t at = from; at < to; at += piece.size()){
+                    const uint64_t n = std::min<uint64_t>(piece.size(), to - at);
+                    decode_symbols(segment, at, at + n, piece.data());
+                    output.write_at(segment.output_offset + at, piece.data(), static_cast<size_t>(n));
+                }
+            }));
+        }
+    }
+    for(auto& task : tasks){
+        task.get();
+    }
+    output.close();
+
+    LOG.info("Parallel decoding completed. Slices: " + std::to_string(tasks.size()) +
+             ", symbols: " + std::to_string(total), "UniDecoder::parallel_decode");
 }
 
 void UniDecoder::start(){
     LOG.info("Starting unidecoder for file: " + input_path_text_, "UniDecoder::start");
 
-    std::ifstream input_text(input_path_text_, std::ios::binary);
-    if(!input_text.is_open()){
-        LOG.error("Error in opening file " + input_path_text_, "UniDecoder::start");
-        throw std::runtime_error("Error in opening file");
+    metrics_ = Metrics{};
+    metrics_.engine = "uniform";
+    metrics_.operation = "decode";
+    segments_.clear();
+    std::vector<uint8_t> head;
+    {
+        PhaseTimer timer(metrics_, "read");
+        if(input_path_text_ != MappedFile::STDIN_PATH){
+            input_.open(input_path_text_);
+        }
+        else{
+            // A container on stdin is decoded as it arrives, anything else is read whole
+            head = stdin_head_ ? std::move(*stdin_head_) : ContainerStream::read_head(std::cin);
+            stdin_head_.reset();
+            if(!Container::is_container(head.data(), head.size())){
+                input_.open(std::cin, head, "stdin");
+            }
+        }
     }
-
-    std::ifstream input_alphabet(input_path_alphabet_);
-    if(!input_alphabet.is_open()){
-        LOG.error("Error in opening file " + input_path_alphabet_, "UniDecoder::start");
-        throw std::runtime_error("Error in opening file");
+    metrics_.bytes_in = input_.size();
+
+    if(!input_.is_open()){
+        LOG.info("Input is a container on stdin, decoding blocks as they arrive", "UniDecoder::start");
+        OutputFile output_file(output_path_);
+        OutputBuffer output(output_file.stream(), static_cast<size_t>(cout_number_));
+        PhaseTimer decode_timer(metrics_, "decode");
+        ContainerStream stream(std::cin, std::move(head), "stdin");
+        if(stream.header().engine != Container::Engine::Uniform){
+            LOG.error("Container is not encoded with the Uniform engine", "UniDecoder::start");
+            throw std::runtime_error("Container is not encoded with the Uniform engine");
+        }
+        metrics_.payload_bits = stream.decode(output);
+        metrics_.bytes_in = stream.position();
+        output.flush();
+        output_file.flush();
+        decode_timer.stop();
+        if(preview_ && !output_file.is_stdout()){
+            std::cout << output.preview();
+        }
+        metrics_.bytes_out = metrics_.symbols = output.total();
     }
+    else{
+        load();
+        uint64_t total = 0;
+        for(const Segment& segment : segments_){
+            metrics_.payload_bits += segment.bit_count;
+            total += segment.symbols;
+        }
 
-    read_alphabet(input_alphabet);
+        LOG.info("Starting text decoding", "UniDecoder::start");
+        PhaseTimer decode_timer(metrics_, "decode");
+        if(threads_ != 1 && !OutputFile::is_stdout_path(output_path_) && total >= 2 * SLICE_SIZE){
+            parallel_decode(total);
+            decode_timer.stop();
+            if(preview_){
+                const std::vector<unsigned char> preview = decode_range(0, std::min<uint64_t>(total, cout_number_));
+                std::cout << std::string(preview.begin(), preview.end());
+            }
+        }
+        else{
+            OutputFile output_file(output_path_);
+            OutputBuffer output(output_file.stream(), static_cast<size_t>(cout_number_));
+            for(const Segment& segment : segments_){
+                decode_segment(segment, output);
+            }
+            output.flush();
+            output_file.flush();
+            decode_timer.stop();
+            if(preview_ && !output_file.is_stdout()){
+                std::cout << output.preview();
+            }
+        }
+        metrics_.bytes_out = metrics_.symbols = total;
+    }
 
-    LOG.info("Starting text decoding", "UniDecoder::start");
-    bit_decode(input_text);
+    LOG_INFO("Decoded {} bytes into {} bytes in {} s, {} MB/s", "UniDecoder::start",
+             metrics_.bytes_in, metrics_.bytes_out, metrics_.total_seconds, metrics_.throughput_mbps());
+    if(!metrics_path_.empty()){
+        metrics_.write_json(metrics_path_);
+    }
 
     LOG.info("Decoding completed successfully", "UniDecoder::start");
 }
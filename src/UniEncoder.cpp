@@ -1,5 +1,10 @@
 #include "UniEncoder.hpp"
+#include "BitWriter.hpp"
+#include "Container.hpp"
+#include "Histogram.hpp"
+#include "UniformKernels.hpp"
 #include "Logger.hpp"
+#include "OutputFile.hpp"
 #include "Encoder.hpp"
 #include <bit>
 #include <cstddef>
@@ -8,44 +13,47 @@
 #include <algorithm>
 #include <ios>
 #include <string>
+#include <vector>
 #include <iostream>
 
 #define LOG Logger::getInstance()
 
 void UniEncoder::make_alphabet(){
+    PhaseTimer histogram_timer(metrics_, "histogram");
     fill_chars();
+    histogram_timer.stop();
+
+    PhaseTimer table_timer(metrics_, "table");
     unsigned symb_idx = 0;
     for(size_t i = 0; i < symbToCode_.size(); ++i){
         if(chars_[i] == 0){
             continue;
         }
 
-        symbToCode_[i].resize(length_);
         encode_sigle_symbol(symb_idx, symbToCode_[i]);
         ++symb_idx;
     }
 }
 
-void UniEncoder::encode_sigle_symbol(unsigned index, std::string& buf){
-    for(unsigned bit = 0; bit < length_; ++bit){
-        unsigned shift = length_ - 1 - bit;
-        buf[bit] = (index >> shift & 1u) ? '1' : '0';
-    }
+void UniEncoder::encode_sigle_symbol(unsigned index, Code& code){
+    code.bits = index;
+    code.length = static_cast<uint8_t>(length_);
 }
 
 void UniEncoder::fill_chars(){
-    std::ifstream inputfile(input_path_);
-    if(!inputfile.is_open()){
-        LOG.error("Error in opening file " + input_path_, "UniEncoder::make_alphabet");
+    if(!input_.is_open()){
+        LOG.error("Input file " + input_path_ + " is not open", "UniEncoder::fill_chars");
         throw std::runtime_error("Error in opening file");
     }
 
+    Histogram histogram(threads_);
+    chars_ = histogram.count(input_.bytes());
+    metrics_.entropy = Metrics::entropy_of(chars_);
     unsigned total = 0;
-    char ch;
-    while(inputfile.get(ch)){
-        if(++chars_[static_cast<unsigned char>(ch)] == 1){
+    for(uint64_t count : chars_){
+        if(count != 0){
             ++total;
-        } 
+        }
     }
     // bit_width(x) returns the floor(log2(x)) + 1
     // We encode total number of symbols starting with index = 0, so we use:
@@ -63,10 +71,10 @@ void UniEncoder::write_alphabet(std::ofstream& output_file){
              "UniEncoder::write_alphabet");
 
     for(size_t i = 0; i < symbToCode_.size(); ++i){
-        if(symbToCode_[i] != ""){
-            output_file << Encoder::format_symbol(static_cast<unsigned char>(i)) << " " << symbToCode_[i] << std::endl;
-            LOG.debug("Symbol: " + Encoder::format_symbol(static_cast<unsigned char>(i)) + " -> Code: " + symbToCode_[i],
-                     "Encoder::write_alphabet");
+        if(!symbToCode_[i].empty()){
+            output_file << Encoder::format_symbol(static_cast<unsigned char>(i)) << " " << symbToCode_[i].to_string() << std::endl;
+            LOG_DEBUG("Symbol: {} -> Code: {}", "UniEncoder::write_alphabet",
+                      Encoder::format_symbol(static_cast<unsigned char>(i)), symbToCode_[i]);
         }
     }
 }
@@ -74,15 +82,42 @@ void UniEncoder::write_alphabet(std::ofstream& output_file){
 void UniEncoder::start(){
     LOG.info("Starting encoder for file: " + input_path_, "UniEncoder::start");
 
+    metrics_ = Metrics{};
+    metrics_.engine = "uniform";
+    metrics_.operation = "encode";
+    {
+        PhaseTimer timer(metrics_, "read");
+        input_.open(input_path_);
+    }
+    metrics_.bytes_in = input_.size();
+    metrics_.symbols = input_.size();
+
     make_alphabet();
     // TODO: Add some checking making alphabet
     LOG.info("Starting text encoding", "UniEncoder::start");
-    bit_encode();
+    if(container_){
+        container_encode();
+    }
+    else{
+        bit_encode();
+    }
+    metrics_.payload_bits = input_.size() == 0 ? 0 : static_cast<uint64_t>(input_.size()) * length_;
 
+    LOG_INFO("Encoded {} bytes into {} bytes in {} s, {} MB/s", "UniEncoder::start",
+             metrics_.bytes_in, metrics_.bytes_out, metrics_.total_seconds, metrics_.throughput_mbps());
+    if(!metrics_path_.empty()){
+        metrics_.write_json(metrics_path_);
+    }
     LOG.info("Encoding completed successfully", "UniEncoder::start");
 }
 
 void UniEncoder::bit_encode(){
+    // Padding is patched into byte 0 after the payload, which needs a seekable file
+    if(OutputFile::is_stdout_path(output_path_text_)){
+        LOG.error("Legacy format cannot be written to stdout, use the container", "UniEncoder::bit_encode");
+        throw std::runtime_error("Legacy format needs a seekable output");
+    }
+
     std::ofstream output_text(output_path_text_, std::ios::binary);
     if(!output_text.is_open()){
         LOG.error("Error in opening file " + output_path_text_, "UniEncoder::bit_encode");
@@ -95,54 +130,123 @@ void UniEncoder::bit_encode(){
         throw std::runtime_error("Error in opening file");
     }
 
-    std::ifstream input_file(input_path_);
-    if(!input_file.is_open()){
-        LOG.error("Error in opening output file " + input_path_, "UniEncoder::bit_encode");
+    if(!input_.is_open()){
+        LOG.error("Input file " + input_path_ + " is not open", "UniEncoder::bit_encode");
         throw std::runtime_error("Error in opening file");
     }
 
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
     write_alphabet(output_alphabet);
+    alphabet_timer.stop();
 
+    PhaseTimer encode_timer(metrics_, "encode");
     // Reserve place for padding in header of file
     uint8_t padding = 0;
     output_text.put(static_cast<char>(padding));
 
-    uint8_t current = 0;
-    size_t filled = 0;
-    char ch;
-    size_t encoded_count = 0;
-
-    while(input_file.get(ch)){
-        unsigned char u_ch = static_cast<unsigned char>(ch);
-        std::string& code = symbToCode_[ch];
-         if(code.empty()){
-            LOG.error("No code found for symbol: " + std::to_string(u_ch), "Encoder::bit_encode");
-            throw std::runtime_error("Error in encoding");
-        }
-        if(encoded_count <= cout_number){
-            std::cout << code;
+    BitWriter writer(output_text);
+    encode_payload(writer, preview_);
+    padding = writer.finish();
+
+    output_text.seekp(0, std::ios::beg);
+    output_text.put(static_cast<char>(padding));
+    output_text.flush();
+    encode_timer.stop();
+
+    metrics_.bytes_out = 1 + (writer.bit_count() + 7) / 8;
+}
+
+void UniEncoder::container_encode(){
+    if(!input_.is_open()){
+        LOG.error("Input file " + input_path_ + " is not open", "UniEncoder::container_encode");
+        throw std::runtime_error("Error in opening file");
+    }
+
+    PhaseTimer alphabet_timer(metrics_, "alphabet");
+    OutputFile output(output_path_text_);
+    std::ostream& output_text = output.stream();
+
+    const size_t size = input_.size();
+
+    Container::Header header;
+    header.engine = Container::Engine::Uniform;
+    header.original_size = size;
+    header.block_size = size;
+    header.block_count = size == 0 ? 0 : 1;
+
+    // Every symbol takes length_ bits, so the payload size is known before encoding
+    std::vector<uint8_t> head;
+    Container::write_header(head, header);
+    if(size != 0){
+        const uint64_t offset = Container::HEADER_SIZE + Container::ENTRY_SIZE;
+        Container::write_directory(head, {{offset, size, static_cast<uint64_t>(size) * length_}});
+        Container::write_codes(head, symbToCode_);
+    }
+    output_text.write(reinterpret_cast<const char*>(head.data()), static_cast<std::streamsize>(head.size()));
+    alphabet_timer.stop();
+
+    PhaseTimer encode_timer(metrics_, "encode");
+    if(size != 0){
+        BitWriter writer(output_text);
+        encode_payload(writer, preview_ && !output.is_stdout());
+        writer.finish();
+    }
+    output.flush();
+    encode_timer.stop();
+
+    metrics_.bytes_out = head.size() + (static_cast<uint64_t>(size) * length_ + 7) / 8;
+}
+
+void UniEncoder::encode_payload(BitWriter& writer, bool preview){
+    if(preview){
+        for(unsigned char u_ch : input_.bytes().first(std::min<size_t>(input_.size(), cout_number + 1))){
+            std::cout << symbToCode_[u_ch].to_string();
         }
+    }
+    encode_span(input_.bytes(), symbToCode_, writer);
+}
 
-        for(auto& c : code){
-            current = static_cast<uint8_t>((current << 1) | (c == '1' ? 1u : 0u));
-            ++filled;
-            if(filled == sizeof(current) * 8){
-                output_text.put(static_cast<char>(current));
-                current = 0;
-                filled = 0;
+void UniEncoder::encode_span(std::span<const uint8_t> data, const std::array<Code, 256>& codes, BitWriter& writer){
+    auto put_each = [&](std::span<const uint8_t> symbols){
+        for(unsigned char u_ch : symbols){
+            const Code& code = codes[u_ch];
+            if(code.empty()){
+                LOG.error("No code found for symbol: " + std::to_string(u_ch), "UniEncoder::encode_span");
+                throw std::runtime_error("Error in encoding");
             }
+            writer.put(code);
         }
-        ++encoded_count;
-    }
+    };
 
-    if(filled != 0){
-        padding = sizeof(current) * 8 - filled;
-        current <<= padding;
-        output_text.put(static_cast<char>(current));
-        filled = 0;
-        current = 0;
+    UniformKernels::ByteMap map;
+    unsigned width = 0;
+    bool same_width = true;
+    for(size_t symbol = 0; symbol < codes.size(); ++symbol){
+        if(codes[symbol].empty()){
+            continue;
+        }
+        same_width &= width == 0 || width == codes[symbol].length;
+        width = codes[symbol].length;
+        map.value[symbol] = static_cast<uint8_t>(codes[symbol].bits);
+        map.valid[symbol] = true;
+    }
+    if(!same_width || width == 0 || width > 8 || writer.bit_count() % 8 != 0){
+        put_each(data);
+        return;
     }
 
-    output_text.seekp(0, std::ios::beg);
-    output_text.put(static_cast<char>(padding));
-}
\ No newline at end of file
+    // Groups of 8 codes end on whole bytes, the last few symbols are put one by one
+    const UniformKernels::Kernels kernels = UniformKernels::for_width(width);
+    const size_t whole = data.size() - data.size() % 8;
+    std::vector<uint8_t> mapped(std::min(whole, CHUNK_SIZE));
+    std::vector<uint8_t> packed(mapped.size() * width / 8);
+    for(size_t i = 0; i < whole; i += CHUNK_SIZE){
+        const size_t n = std::min(CHUNK_SIZE, whole - i);
+        if(UniformKernels::map(data.data() + i, n, map, mapped.data()) != n){
+            put_each(data.subspan(i, n));   // throws for the symbol with no code
+        }
+        kernels.pack(mapped.data(), n, packed.data());
+        writer.put_bytes(packed.data(), n * width / 8);
+    }
+    put_each(data.subspan(whole));
+}
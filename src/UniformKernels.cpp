@@ -0,0 +1,332 @@
+#include "UniformKernels.hpp"
+#include "Logger.hpp"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FANO_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define LOG Logger::getInstance()
+
+namespace{
+
+using Isa = UniformKernels::Isa;
+
+uint64_t load64(const uint8_t* p){
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void store64(uint8_t* p, uint64_t v){
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// Every implementation is a class template over the code width L with static
+// pack and unpack, so shifts, masks and shuffle tables are constants and the
+// loops over a group of 8 codes (L bytes) unroll completely
+template<unsigned L>
+struct Scalar{
+    static constexpr uint64_t MASK = (1u << L) - 1u;
+
+    static void pack(const uint8_t* codes, size_t count, uint8_t* out){
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8){
+            uint64_t v = 0;
+            for(size_t j = 0; j < 8; ++j){
+                v = (v << L) | codes[i + j];
+            }
+            for(unsigned b = 0; b < L; ++b){
+                out[b] = static_cast<uint8_t>(v >> (8 * (L - 1 - b)));
+            }
+            out += L;
+        }
+
+        // Less than 8 codes left, the last byte is zero-padded
+        const unsigned bits = static_cast<unsigned>(count - i) * L;
+        const unsigned bytes = (bits + 7) / 8;
+        uint64_t v = 0;
+        for(; i < count; ++i){
+            v = (v << L) | codes[i];
+        }
+        v <<= bytes * 8 - bits;
+        for(unsigned b = 0; b < bytes; ++b){
+            out[b] = static_cast<uint8_t>(v >> (8 * (bytes - 1 - b)));
+        }
+    }
+
+    static void unpack(const uint8_t* data, size_t count, uint8_t* codes){
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8){
+            uint64_t v = 0;
+            for(unsigned b = 0; b < L; ++b){
+                v = (v << 8) | data[b];
+            }
+            for(size_t j = 0; j < 8; ++j){
+                codes[i + j] = static_cast<uint8_t>((v >> (L * (7 - j))) & MASK);
+            }
+            data += L;
+        }
+
+        const unsigned left = static_cast<unsigned>(count - i);
+        const unsigned bytes = (left * L + 7) / 8;
+        uint64_t v = 0;
+        for(unsigned b = 0; b < bytes; ++b){
+            v = (v << 8) | data[b];
+        }
+        for(unsigned j = 0; j < left; ++j){
+            codes[i + j] = static_cast<uint8_t>((v >> (bytes * 8 - L * (j + 1))) & MASK);
+        }
+    }
+};
+
+#ifdef FANO_X86_KERNELS
+
+// A group of 8 codes is one 64-bit word: byte-swapped, code 0 is the top byte,
+// pext squeezes the low L bits of every byte together and keeps that order.
+// Whole words are stored, the bytes past the group are written over by the next ones,
+// so the loop stops 8 bytes before the end and the scalar one finishes
+template<unsigned L>
+struct Bmi2{
+    static constexpr uint64_t MASK = 0x0101010101010101ull * ((1u << L) - 1u);
+    static constexpr unsigned SHIFT = 64 - 8 * L;
+
+    __attribute__((target("bmi2")))
+    static void pack(const uint8_t* codes, size_t count, uint8_t* out){
+        size_t i = 0;
+        for(; i + 72 <= count; i += 8){
+            const uint64_t v = _pext_u64(__builtin_bswap64(load64(codes + i)), MASK);
+            store64(out, __builtin_bswap64(v << SHIFT));
+            out += L;
+        }
+        Scalar<L>::pack(codes + i, count - i, out);
+    }
+
+    __attribute__((target("bmi2")))
+    static void unpack(const uint8_t* data, size_t count, uint8_t* codes){
+        size_t i = 0;
+        for(; i + 72 <= count; i += 8){
+            const uint64_t v = __builtin_bswap64(load64(data)) >> SHIFT;
+            store64(codes + i, __builtin_bswap64(_pdep_u64(v, MASK)));
+            data += L;
+        }
+        Scalar<L>::unpack(data, count - i, codes + i);
+    }
+};
+
+// 32 codes per step, each 128-bit lane holds two groups of 8.
+// Packing merges neighbours with shifts: pairs in 16-bit lanes, fours in 32-bit,
+// groups in 64-bit ones, then a shuffle puts the bytes of both groups of a lane
+// in stream order. Unpacking gathers the two bytes holding each code into a
+// 16-bit lane, moves the code to the top with a multiply by 2^offset and shifts
+// it down. Loads and stores of 16 bytes may pass the end of the 4 * L used
+// ones, the loops stop 128 codes before the end
+template<unsigned L>
+struct Avx2{
+    // Shuffle of a packed lane: bytes of both groups, most significant first
+    static constexpr std::array<uint8_t, 32> ORDER = []{
+        std::array<uint8_t, 32> order{};
+        for(unsigned lane = 0; lane < 2; ++lane){
+            for(unsigned j = 0; j < 16; ++j){
+                uint8_t from = 0x80;
+                if(j < L){
+                    from = static_cast<uint8_t>(L - 1 - j);
+                }
+                else if(j < 2 * L){
+                    from = static_cast<uint8_t>(8 + 2 * L - 1 - j);
+                }
+                order[lane * 16 + j] = from;
+            }
+        }
+        return order;
+    }();
+
+    // Shuffle of an unpacked lane: bytes holding code j, big-endian in 16-bit lane j
+    static constexpr std::array<uint8_t, 32> GATHER = []{
+        std::array<uint8_t, 32> gather{};
+        for(unsigned lane = 0; lane < 2; ++lane){
+            for(unsigned j = 0; j < 8; ++j){
+                gather[lane * 16 + 2 * j] = static_cast<uint8_t>(j * L / 8 + 1);
+                gather[lane * 16 + 2 * j + 1] = static_cast<uint8_t>(j * L / 8);
+            }
+        }
+        return gather;
+    }();
+
+    // 2^(bit offset of code j in its first byte)
+    static constexpr std::array<uint16_t, 16> SCALE = []{
+        std::array<uint16_t, 16> scale{};
+        for(unsigned j = 0; j < 16; ++j){
+            scale[j] = static_cast<uint16_t>(1u << (j % 8 * L % 8));
+        }
+        return scale;
+    }();
+
+    __attribute__((target("avx2")))
+    static void pack(const uint8_t* codes, size_t count, uint8_t* out){
+        const __m256i order = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ORDER.data()));
+        const __m256i low8 = _mm256_set1_epi16(0x00ff);
+        const __m256i low16 = _mm256_set1_epi32(0xffff);
+        const __m256i low32 = _mm256_set1_epi64x(0xffffffff);
+
+        size_t i = 0;
+        for(; i + 32 + 128 <= count; i += 32){
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i));
+            x = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(x, low8), L), _mm256_srli_epi16(x, 8));
+            x = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, low16), 2 * L), _mm256_srli_epi32(x, 16));
+            x = _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(x, low32), 4 * L), _mm256_srli_epi64(x, 32));
+            x = _mm256_shuffle_epi8(x, order);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * L), _mm256_extracti128_si256(x, 1));
+            out += 4 * L;
+        }
+        Scalar<L>::pack(codes + i, count - i, out);
+    }
+
+    // Codes of two groups, one per 128-bit lane, in 16-bit lanes
+    __attribute__((target("avx2")))
+    static __m256i codes16(const uint8_t* p, __m256i gather, __m256i scale){
+        __m256i x = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + L)), 1);
+        x = _mm256_shuffle_epi8(x, gather);
+        return _mm256_srli_epi16(_mm256_mullo_epi16(x, scale), 16 - L);
+    }
+
+    __attribute__((target("avx2")))
+    static void unpack(const uint8_t* data, size_t count, uint8_t* codes){
+        const __m256i gather = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(GATHER.data()));
+        const __m256i scale = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SCALE.data()));
+
+        size_t i = 0;
+        for(; i + 32 + 128 <= count; i += 32){
+            const __m256i low = codes16(data, gather, scale);
+            const __m256i high = codes16(data + 2 * L, gather, scale);
+            const __m256i x = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), x);
+            data += 4 * L;
+        }
+        Scalar<L>::unpack(data, count - i, codes + i);
+    }
+};
+
+#endif
+
+using Table = std::array<UniformKernels::Kernels, UniformKernels::MAX_WIDTH>;
+
+// Instantiations of an implementation for widths 1..MAX_WIDTH
+template<template<unsigned> class Impl, unsigned... I>
+constexpr Table make_table(std::integer_sequence<unsigned, I...>){
+    return {{ {I + 1, Impl<I + 1>::pack, Impl<I + 1>::unpack}... }};
+}
+
+template<template<unsigned> class Impl>
+constexpr Table make_table(){
+    return make_table<Impl>(std::make_integer_sequence<unsigned, UniformKernels::MAX_WIDTH>{});
+}
+
+constexpr Table SCALAR_TABLE = make_table<Scalar>();
+#ifdef FANO_X86_KERNELS
+constexpr Table BMI2_TABLE = make_table<Bmi2>();
+constexpr Table AVX2_TABLE = make_table<Avx2>();
+#endif
+
+struct Active{
+    Isa isa;
+    const Table* table;
+};
+
+Active active_of(Isa isa){
+    switch(isa){
+#ifdef FANO_X86_KERNELS
+        case Isa::Avx2:
+            return {isa, &AVX2_TABLE};
+        case Isa::Bmi2:
+            return {isa, &BMI2_TABLE};
+#endif
+        default:
+            return {Isa::Scalar, &SCALAR_TABLE};
+    }
+}
+
+Active& active(){
+    static Active current = active_of(UniformKernels::best());
+    return current;
+}
+
+}
+
+bool UniformKernels::supported(Isa isa){
+#ifdef FANO_X86_KERNELS
+    __builtin_cpu_init();
+    switch(isa){
+        case Isa::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case Isa::Bmi2:
+            return __builtin_cpu_supports("bmi2");
+        case Isa::Scalar:
+            return true;
+    }
+    return false;
+#else
+    return isa == Isa::Scalar;
+#endif
+}
+
+UniformKernels::Isa UniformKernels::best(){
+    if(supported(Isa::Avx2)){
+        return Isa::Avx2;
+    }
+    if(supported(Isa::Bmi2)){
+        return Isa::Bmi2;
+    }
+    return Isa::Scalar;
+}
+
+UniformKernels::Isa UniformKernels::isa(){
+    return active().isa;
+}
+
+void UniformKernels::set_isa(Isa isa){
+    if(!supported(isa)){
+        LOG.error(std::string("CPU does not support ") + name(isa) + " kernels", "UniformKernels::set_isa");
+        throw std::runtime_error(std::string("Unsupported kernels: ") + name(isa));
+    }
+    active() = active_of(isa);
+}
+
+const char* UniformKernels::name(Isa isa){
+    switch(isa){
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Bmi2:
+            return "bmi2";
+        case Isa::Scalar:
+            return "scalar";
+    }
+    return "unknown";
+}
+
+UniformKernels::Kernels UniformKernels::for_width(unsigned width){
+    if(width == 0 || width > MAX_WIDTH){
+        LOG.error("Invalid code width " + std::to_string(width), "UniformKernels::for_width");
+        throw std::invalid_argument("Code width must be from 1 to 8");
+    }
+    return (*active().table)[width - 1];
+}
+
+size_t UniformKernels::map(const uint8_t* in, size_t count, const ByteMap& map, uint8_t* out){
+    for(size_t i = 0; i < count; ++i){
+        const uint8_t byte = in[i];
+        if(!map.valid[byte]){
+            return i;
+        }
+        out[i] = map.value[byte];
+    }
+    return count;
+}
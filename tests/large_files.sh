@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# Round trips of a sparse input larger than 4 GiB through both engines:
+# file to file, and file to stdout piped into a decoder reading stdin and
+# writing stdout. Symbol counts and sizes must pass 2^32 on every side.
+# Encoding reads the file, encoding from stdin would buffer all of it.
+# usage: large_files.sh FANO WORK_DIR
+set -euo pipefail
+
+fano=$1
+work=$2
+mkdir -p "$work"
+trap 'rm -rf "$work"' EXIT
+
+limit=$((1 << 32))
+size=$((limit + (1 << 20)))
+input=$work/sparse.bin
+
+fail(){
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# Value of a numeric field of the last metrics line
+field(){
+    tail -n 1 "$1" | grep -o "\"$2\":[0-9]*" | cut -d: -f2
+}
+
+# Values must pass 2^32
+check_counts(){
+    local metrics=$1 what=$2
+    local symbols bytes_in
+    symbols=$(field "$metrics" symbols)
+    bytes_in=$(field "$metrics" bytes_in)
+    [ "${symbols:-0}" -eq "$size" ] || fail "$what: $symbols symbols instead of $size"
+    [ "$symbols" -gt "$limit" ] || fail "$what: symbols do not pass 2^32"
+    echo "$what: $symbols symbols, $bytes_in bytes in"
+}
+
+# Original size recorded in bytes 8..15 of the container header
+header_size(){
+    od -An -t u8 -j 8 -N 8 "$1" | tr -d ' '
+}
+
+truncate -s "$size" "$input"
+# A few other symbols, around the 2^32 boundary too, so codes are not all one bit
+for offset in 0 4095 $((limit - 3)) "$limit" $((limit + 1)) $((size - 4)); do
+    printf 'Fano' | dd of="$input" bs=1 seek="$offset" conv=notrunc status=none
+done
+[ "$(stat -c %s "$input")" -eq "$size" ] || fail "input is not $size bytes"
+
+for engine in fano uniform; do
+    encoded=$work/$engine.fano
+    decoded=$work/$engine.out
+
+    "$fano" -q -e --engine "$engine" --metrics "$work/encode.json" -o "$encoded" "$input"
+    check_counts "$work/encode.json" "$engine encode"
+    [ "$(header_size "$encoded")" -eq "$size" ] || fail "$engine header holds $(header_size "$encoded") bytes"
+
+    "$fano" -q -d --metrics "$work/decode.json" -o "$decoded" "$encoded"
+    check_counts "$work/decode.json" "$engine decode"
+    [ "$(stat -c %s "$decoded")" -eq "$size" ] || fail "$engine decoded $(stat -c %s "$decoded") bytes"
+    cmp "$decoded" "$input" || fail "$engine file round trip differs"
+    rm -f "$decoded" "$encoded"
+
+    "$fano" -q -e --engine "$engine" --metrics "$work/encode.json" -o - "$input" |
+        "$fano" -q -d --metrics "$work/decode.json" -o - - | cmp - "$input" || fail "$engine pipe round trip differs"
+    check_counts "$work/encode.json" "$engine pipe encode"
+    check_counts "$work/decode.json" "$engine pipe decode"
+done
+
+echo "large files done"